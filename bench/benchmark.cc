@@ -0,0 +1,207 @@
+// benchmark.cc
+
+// Copyright 2019 E. Decker
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures the start of "function_word_vector_killer" (loading the function
+// words or mapping a compiled dictionary), the parts that are run for every
+// word vector (building and searching the "FunctionWordSet",
+// "CompoundMatcher::Match()", "FoldCase()", "SetToLowerCase()",
+// "TokenClassifier::Classify()", "WordFilter::Removes()") and the whole program
+// on a word vector file (e.g. one written by "generate_vectors"). The results
+// are reported in items (words or lines) and megabytes per second.
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "function_word_vector_killer.h"
+
+namespace {
+
+const double kMinSecondsPerBenchmark = 0.5;
+
+double SecondsSince(const std::chrono::steady_clock::time_point& start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+}
+
+void Report(const std::string& name, const double num_of_items, const double num_of_bytes, const double seconds) {
+  printf("%-40s %14.0f %12.1f\n", name.c_str(), num_of_items/seconds, num_of_bytes/seconds/1e6);
+}
+
+template <typename Function>
+void Run(const std::string& name, const std::vector<std::string>& words, Function function) {
+// Calls "function" for every word in "words" (again and again until at least
+// "kMinSecondsPerBenchmark" have passed) and reports the words per second.
+  size_t num_of_bytes_per_round = 0;
+  for (const auto& word : words)
+    num_of_bytes_per_round += word.size();
+  long long num_of_rounds = 0, checksum = 0;
+  const auto start = std::chrono::steady_clock::now();
+  do {
+    for (const auto& word : words)
+      checksum += function(word);
+    num_of_rounds++;
+  } while (SecondsSince(start) < kMinSecondsPerBenchmark);
+  const double seconds = SecondsSince(start);
+  Report(name, (double) num_of_rounds*words.size(), (double) num_of_rounds*num_of_bytes_per_round, seconds);
+  if (checksum == 42) // keeps the compiler from optimizing the calls away
+    std::cerr << ' ';
+}
+
+std::vector<std::string> LoadAllFunctionWords(const std::string& language) {
+  std::vector<std::string> words;
+  for (const auto& file_name : kCategoryNames) {
+    std::ifstream file_stream("data/"+language+"/"+file_name+".txt");
+    std::string word;
+    while (file_stream >> word)
+      words.push_back(word);
+  }
+  return words;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::string input_file, language = "english";
+  unsigned num_of_threads = 4;
+  for (int i = 1; i < argc; ++i) {
+    const std::string argument = argv[i];
+    if (argument == "--lang" && i+1 < argc)
+      language = argv[++i];
+    else if (argument == "--threads" && i+1 < argc)
+      num_of_threads = std::stoul(argv[++i]);
+    else
+      input_file = argument;
+  }
+  const MappedFile input(input_file);
+  if (input_file.empty() || !input.IsMapped()) {
+    std::cerr << "Style of usage:\n\t./benchmark [word_vector_file] [--lang english|german] [--threads N]\n";
+    return -1;
+  }
+  // Collects (up to a million of) the words of the word vector file.
+  const VectorFileHeader header = ReadVectorFileHeader(input.data(), input.data()+input.size());
+  std::vector<std::string> words, lower_case_words;
+  long long num_of_lines = 0;
+  for (const char* line_begin = input.data()+header.length; line_begin < input.data()+input.size(); num_of_lines++) {
+    const char* line_end = static_cast<const char*>(memchr(line_begin, '\n', input.data()+input.size()-line_begin));
+    line_end = (line_end == NULL)? input.data()+input.size() : line_end+1;
+    if (words.size() < 1000000) {
+      const char* word_end = static_cast<const char*>(memchr(line_begin, ' ', line_end-line_begin));
+      words.emplace_back(line_begin, (word_end == NULL)? line_end : word_end);
+      lower_case_words.push_back(SetToLowerCase(words.back()));
+    }
+    line_begin = line_end;
+  }
+  const std::vector<std::string> function_words = LoadAllFunctionWords(language);
+  printf("%s: %lld lines, %.1f MB; %zu function words (%s)\n\n", input_file.c_str(), num_of_lines, input.size()/1e6, function_words.size(), language.c_str());
+  printf("%-40s %14s %12s\n", "benchmark", "items/s", "MB/s");
+
+  long long num_of_builds = 0;
+  size_t set_size = 0;
+  auto start = std::chrono::steady_clock::now();
+  do {
+    const FunctionWordSet function_word_set(function_words);
+    set_size += function_word_set.size();
+    num_of_builds++;
+  } while (SecondsSince(start) < kMinSecondsPerBenchmark);
+  Report("FunctionWordSet (build, words)", (double) num_of_builds*function_words.size(), 0, SecondsSince(start));
+
+  // Compares what is done at the start of every run: loading the txt-files of
+  // all categories or mapping a compiled dictionary (see "--dict").
+  const std::string dictionary_file = "bench/benchmark.dict";
+  std::streambuf* const cout_buffer = std::cout.rdbuf(NULL); // only errors are shown
+  if (!CompileDictionary("data/"+language, dictionary_file))
+    return -1;
+  std::streambuf* const cerr_buffer = std::cerr.rdbuf(NULL);
+  long long num_of_loads = 0;
+  start = std::chrono::steady_clock::now();
+  do {
+    std::vector<std::string> loaded_words;
+    std::vector<uint16_t> category_masks;
+    for (int i = 0; i < kNumOfCategories; ++i) {
+      for (const auto& word : LoadFunctionWordFile("data/"+language+"/"+kCategoryNames[i]+".txt")) {
+        loaded_words.push_back(SetToLowerCase(word));
+        category_masks.push_back(1 << i);
+      }
+    }
+    set_size += FunctionWordSet(loaded_words, category_masks).size();
+    num_of_loads++;
+  } while (SecondsSince(start) < kMinSecondsPerBenchmark);
+  std::cout.rdbuf(cout_buffer);
+  std::cerr.rdbuf(cerr_buffer);
+  Report("Load txt-files and build (loads)", num_of_loads, 0, SecondsSince(start));
+  num_of_loads = 0;
+  start = std::chrono::steady_clock::now();
+  do {
+    set_size += FunctionWordSet(dictionary_file).size();
+    num_of_loads++;
+  } while (SecondsSince(start) < kMinSecondsPerBenchmark);
+  Report("Map compiled dictionary (loads)", num_of_loads, 0, SecondsSince(start));
+  std::remove(dictionary_file.c_str());
+
+  const FunctionWordSet function_word_set(function_words);
+  Run("FunctionWordSet::Find", lower_case_words, [&](const std::string& word) { return function_word_set.Find(word); });
+  Run("FunctionWordSet::Find (function words)", function_words, [&](const std::string& word) { return function_word_set.Find(word); });
+  std::vector<uint16_t> category_masks(function_words.size(), 1);
+  const FunctionWordSet categorized_function_word_set(function_words, category_masks);
+  const CompoundMatcher compound_matcher(categorized_function_word_set, 1);
+  std::vector<std::string> compounds;
+  for (size_t i = 0; i+2 < function_words.size(); i += 3)
+    compounds.push_back(SetToLowerCase(function_words[i]+"_"+function_words[i+1]+"-"+function_words[i+2]));
+  Run("CompoundMatcher::Match", lower_case_words, [&](const std::string& word) { return compound_matcher.Match(word); });
+  Run("CompoundMatcher::Match (compounds)", compounds, [&](const std::string& word) { return compound_matcher.Match(word); });
+  std::string folded_word;
+  Run("FoldCase", words, [&](const std::string& word) { FoldCase(word.data(), word.data()+word.size(), folded_word); return folded_word.size(); });
+  Run("tolower() byte by byte (for comparison)", words, [&](const std::string& word) {
+    folded_word = word;
+    for (auto& character : folded_word)
+      character = tolower(character);
+    return folded_word.size();
+  });
+  Run("SetToLowerCase", words, [](const std::string& word) { return SetToLowerCase(word).size(); });
+  const TokenClassifier number_classifier(1 << kNumberRule), token_classifier((1 << kLengthRule)-1, 2, 30);
+  Run("TokenClassifier::Classify (numbers)", lower_case_words, [&](const std::string& word) { return number_classifier.Classify(word); });
+  Run("TokenClassifier::Classify (all rules)", lower_case_words, [&](const std::string& word) { return token_classifier.Classify(word); });
+  KillerOptions compound_options;
+  compound_options.match_compounds = true;
+  const WordFilter word_filter(categorized_function_word_set, 1, compound_options);
+  Run("WordFilter::Removes (words as they are)", words, [&](const std::string& word) { return word_filter.Removes(word); });
+
+  // Runs the whole program (without its messages) with all categories.
+  std::stringstream discarded_messages;
+  std::cout.rdbuf(discarded_messages.rdbuf());
+  const std::string output_file = "bench/benchmark_output.vec";
+  std::vector<unsigned> thread_counts = {1};
+  if (num_of_threads > 1)
+    thread_counts.push_back(num_of_threads);
+  for (const unsigned threads : thread_counts) {
+    KillerOptions options;
+    options.num_of_threads = threads;
+    start = std::chrono::steady_clock::now();
+    Killer(input_file, output_file, std::vector<bool>(10, true), (language == "english")? 0 : 1, options);
+    const double seconds = SecondsSince(start);
+    std::cout.rdbuf(cout_buffer);
+    Report("Killer (end to end, "+std::to_string(threads)+" thread"+((threads > 1)? "s" : "")+", lines)", num_of_lines, input.size(), seconds);
+    std::cout.rdbuf(discarded_messages.rdbuf());
+  }
+  std::cout.rdbuf(cout_buffer);
+  std::remove(output_file.c_str());
+  return (set_size > 0)? 0 : -1;
+}
@@ -0,0 +1,158 @@
+// generate_vectors.cc
+
+// Copyright 2019 E. Decker
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Writes a synthetic word vector file (with a "vocab_size dim" header line)
+// to benchmark "function_word_vector_killer". Function words are taken from
+// the txt-files in "data/<language>". Real word vector files are usually
+// sorted by frequency, so function words are found near their beginning: with
+// "--zipf s" the probability that the word at rank r is a function word is
+// proportional to r^(-s) (s = 0 spreads them evenly).
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<std::string> LoadAllFunctionWords(const std::string& language) {
+  const std::vector<std::string> file_names = {"adpositions", "articles_and_the_like", "conjunctions_and_subjunctions", "interjections", "interrogative_words", "numerals", "particles", "personal_pronouns_and_possessives", "temporal_words", "miscellaneous_words"};
+  std::vector<std::string> words;
+  for (const auto& file_name : file_names) {
+    std::ifstream file_stream("data/"+language+"/"+file_name+".txt");
+    std::string word;
+    while (file_stream >> word)
+      words.push_back(word);
+  }
+  return words;
+}
+
+std::vector<double> GetFunctionWordProbabilities(const long long vocab_size, const double density, const double zipf_exponent) {
+// Returns the probability of being a function word for every rank; they are
+// proportional to rank^(-zipf_exponent) (but at most 1) and add up to
+// "density"*"vocab_size" (found by bisecting the factor).
+  std::vector<double> probabilities(vocab_size);
+  double low = 0, high = 1;
+  const double target = density*vocab_size;
+  auto expected_num_of_function_words = [&](const double factor) {
+    double sum = 0;
+    for (long long rank = 1; rank <= vocab_size; ++rank)
+      sum += std::min(1.0, factor*std::pow(rank, -zipf_exponent));
+    return sum;
+  };
+  while (expected_num_of_function_words(high) < target && high < 1e18)
+    high *= 2;
+  for (int i = 0; i < 40; ++i) {
+    const double middle = (low+high)/2;
+    (expected_num_of_function_words(middle) < target)? low = middle : high = middle;
+  }
+  for (long long rank = 1; rank <= vocab_size; ++rank)
+    probabilities[rank-1] = std::min(1.0, high*std::pow(rank, -zipf_exponent));
+  return probabilities;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  long long vocab_size = 100000, dimension = 300;
+  double density = 0.002, zipf_exponent = 1.0;
+  std::string language = "english", output_file = "synthetic_vectors.vec";
+  bool binary = false;
+  unsigned seed = 1;
+  for (int i = 1; i < argc; ++i) {
+    const std::string argument = argv[i];
+    const bool has_value = i+1 < argc;
+    if (argument == "--vocab" && has_value)
+      vocab_size = std::stoll(argv[++i]);
+    else if (argument == "--dim" && has_value)
+      dimension = std::stoll(argv[++i]);
+    else if (argument == "--function-word-density" && has_value)
+      density = std::stod(argv[++i]);
+    else if (argument == "--zipf" && has_value)
+      zipf_exponent = std::stod(argv[++i]);
+    else if (argument == "--lang" && has_value)
+      language = argv[++i];
+    else if (argument == "--seed" && has_value)
+      seed = std::stoul(argv[++i]);
+    else if (argument == "--binary")
+      binary = true;
+    else if (argument == "-o" && has_value)
+      output_file = argv[++i];
+    else {
+      std::cerr << "Style of usage:\n\t./generate_vectors [--vocab N] [--dim D] [--function-word-density P] [--zipf S] [--lang english|german] [--seed N] [--binary] [-o file]\n";
+      return -1;
+    }
+  }
+  std::vector<std::string> function_words = LoadAllFunctionWords(language);
+  if (function_words.empty()) {
+    std::cerr << "ERROR: NO FUNCTION WORDS FOUND IN \"data/" << language << "\"!\n";
+    return -1;
+  }
+  std::mt19937_64 rng(seed);
+  std::shuffle(function_words.begin(), function_words.end(), rng);
+  const std::vector<double> probabilities = GetFunctionWordProbabilities(vocab_size, density, zipf_exponent);
+  FILE* output = fopen(output_file.c_str(), "wb");
+  if (output == NULL) {
+    std::cerr << "ERROR: CREATING \"" << output_file << "\" FAILED!\n";
+    return -1;
+  }
+  std::vector<char> buffer(1 << 22);
+  setvbuf(output, buffer.data(), _IOFBF, buffer.size());
+  fprintf(output, "%lld %lld\n", vocab_size, dimension);
+  std::uniform_real_distribution<double> uniform(0, 1);
+  std::uniform_int_distribution<int> word_length(3, 12), letter(0, 25), value(0, 199999);
+  long long num_of_function_words = 0;
+  size_t next_function_word = 0;
+  std::string word, line;
+  for (long long rank = 0; rank < vocab_size; ++rank) {
+    if (uniform(rng) < probabilities[rank]) {
+      word = function_words[next_function_word++ % function_words.size()];
+      if (uniform(rng) < 0.1) // some function words are capitalized
+        word[0] = toupper(static_cast<unsigned char>(word[0]));
+      num_of_function_words++;
+    } else {
+      word.resize(word_length(rng));
+      for (auto& character : word)
+        character = 'a'+letter(rng);
+    }
+    line = word;
+    if (binary) {
+      line += ' ';
+      for (long long i = 0; i < dimension; ++i) {
+        const float number = (value(rng)-100000)/100000.0f;
+        line.append(reinterpret_cast<const char*>(&number), sizeof(number));
+      }
+    } else {
+      // Writes values like "-0.12345" without "printf()", which would take
+      // longer than the rest of the program.
+      for (long long i = 0; i < dimension; ++i) {
+        const int number = value(rng)-100000, magnitude = std::abs(number);
+        const char digits[7] = {char('0'+magnitude/100000), '.', char('0'+magnitude/10000%10), char('0'+magnitude/1000%10), char('0'+magnitude/100%10), char('0'+magnitude/10%10), char('0'+magnitude%10)};
+        line += (number < 0)? " -" : " ";
+        line.append(digits, sizeof(digits));
+      }
+    }
+    line += '\n';
+    fwrite(line.data(), 1, line.size(), output);
+  }
+  fclose(output);
+  std::cerr << "Wrote " << vocab_size << " word vectors (" << num_of_function_words << " function words) of dimension " << dimension << " to \"" << output_file << "\".\n";
+  return 0;
+}
@@ -0,0 +1,177 @@
+// batch.cc
+
+// Copyright 2019 E. Decker
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cerrno>
+#include <fstream>
+#include <iostream>
+#include <set>
+
+#include <glob.h>
+#include <sys/stat.h>
+
+#include "function_word_vector_killer.h"
+
+namespace {
+
+std::string GetFileName(const std::string& path) {
+// Returns the part of "path" behind the last slash.
+  const size_t last_slash = path.find_last_of('/');
+  return (last_slash == std::string::npos)? path : path.substr(last_slash+1);
+}
+
+bool EndsWith(const std::string& string, const std::string& suffix) {
+  return string.length() >= suffix.length() && string.compare(string.length()-suffix.length(), suffix.length(), suffix) == 0;
+}
+
+}  // namespace
+
+bool CollectInputFiles(const std::vector<std::string>& patterns, const std::string& list_file, std::vector<std::string>& input_files) {
+// Adds the files matching "patterns" (file names or glob patterns like
+// "shards/*.txt", which are expanded here so that they can be quoted when
+// there are more files than the shell accepts) and the files listed in
+// "list_file" (one per line, if not empty) to "input_files". Returns "false"
+// if a pattern doesn't match any file or "list_file" can't be read.
+  for (const auto& pattern : patterns) {
+    if (pattern.find_first_of("*?[") == std::string::npos) {
+      input_files.push_back(pattern);
+      continue;
+    }
+    glob_t matches;
+    if (glob(pattern.c_str(), 0, NULL, &matches) != 0) {
+      std::cerr << "ERROR: NO FILE MATCHES \"" << pattern << "\"!\n";
+      globfree(&matches);
+      return false;
+    }
+    for (size_t i = 0; i < matches.gl_pathc; ++i)
+      input_files.push_back(matches.gl_pathv[i]);
+    globfree(&matches);
+  }
+  if (!list_file.empty()) {
+    if (!FileIsValid(list_file))
+      return false;
+    std::ifstream file_stream(list_file);
+    std::string line;
+    while (std::getline(file_stream, line)) {
+      if (!line.empty() && line.back() == '\r')
+        line.pop_back();
+      if (!line.empty())
+        input_files.push_back(line);
+    }
+  }
+  return true;
+}
+
+bool RunBatch(const std::vector<std::string>& input_files, const std::string& output_directory, const std::vector<bool>& words_to_remove, const int language, const KillerOptions& options) {
+// Removes the function words from all "input_files" and writes the results to
+// files of the same names in "output_directory" (with ".gz" added if they
+// shall be compressed). The function words are loaded only once and the files
+// are processed by "options.num_of_threads" threads, one file per thread (a
+// "WorkStealingPool" balances large and small files). Returns "false" if any
+// file failed.
+  if (mkdir(output_directory.c_str(), 0755) != 0 && errno != EEXIST) {
+    std::cerr << "ERROR: CREATING \"" << output_directory << "\" FAILED!\n";
+    return false;
+  }
+  const size_t num_of_files = input_files.size();
+  std::vector<std::string> output_files(num_of_files);
+  std::vector<long long> file_sizes(num_of_files, 0);
+  std::set<std::string> used_output_files;
+  for (size_t i = 0; i < num_of_files; ++i) {
+    output_files[i] = output_directory+"/"+GetFileName(input_files[i]);
+    if (options.compress_output && !EndsWith(output_files[i], ".gz"))
+      output_files[i] += ".gz";
+    // Two input files of the same name (from different directories) would
+    // overwrite each other's output file, and an input file must not be
+    // overwritten by its own output file.
+    struct stat input_status, output_status;
+    const bool input_exists = stat(input_files[i].c_str(), &input_status) == 0;
+    if (!used_output_files.insert(output_files[i]).second || (input_exists && stat(output_files[i].c_str(), &output_status) == 0 && input_status.st_dev == output_status.st_dev && input_status.st_ino == output_status.st_ino)) {
+      std::cerr << "ERROR: \"" << input_files[i] << "\" WOULD OVERWRITE \"" << output_files[i] << "\"! Use another output directory or rename the input file.\n";
+      return false;
+    }
+    file_sizes[i] = (input_exists)? input_status.st_size : 0;
+  }
+  const std::unique_ptr<FunctionWordSet> function_words = LoadFunctionWordSet(words_to_remove, language, options);
+  if (!function_words)
+    return false;
+  std::cout << "\nThe following words will be removed from " << num_of_files << " word vector files:\n";
+  PrintFunctionWords(*function_words, GetCategoryMask(words_to_remove));
+  const unsigned num_of_threads = std::min((size_t) std::max(options.num_of_threads, 1u), std::max(num_of_files, (size_t) 1));
+  std::cout << "\n\tCreating " << num_of_files << " new files in \"" << output_directory << "\" (" << num_of_threads << " thread" << ((num_of_threads > 1)? "s" : "") << ")..." << std::endl;
+  // Each file is checked by a single thread without progress lines or
+  // statistics files of its own; the summary is printed at the end.
+  KillerOptions file_options = options;
+  file_options.num_of_threads = 1;
+  file_options.progress_interval = 0;
+  file_options.statistics_file.clear();
+  std::vector<RunStatistics> file_statistics(num_of_files);
+  std::vector<bool> file_failed(num_of_files, false);
+  std::mutex output_mutex;
+  size_t num_of_finished_files = 0;
+  std::vector<size_t> order(num_of_files);
+  for (size_t i = 0; i < num_of_files; ++i)
+    order[i] = i;
+  std::stable_sort(order.begin(), order.end(), [&](const size_t a, const size_t b) { return file_sizes[a] > file_sizes[b]; });
+  const auto start = std::chrono::steady_clock::now();
+  WorkStealingPool pool(num_of_threads);
+  for (const size_t i : order) {
+    pool.Add([&, i]() {
+      KillerOptions killer_options = file_options;
+      killer_options.compress_output = options.compress_output || EndsWith(output_files[i], ".gz");
+      const Killer killer(input_files[i], output_files[i], words_to_remove, *function_words, killer_options);
+      file_statistics[i] = killer.statistics();
+      std::lock_guard<std::mutex> lock(output_mutex);
+      file_failed[i] = killer.failed();
+      std::cout << "\t[" << ++num_of_finished_files << "/" << num_of_files << "] \"" << input_files[i] << "\"" << ((killer.failed())? " FAILED" : " done") << std::endl;
+    });
+  }
+  pool.Run();
+  RunStatistics total;
+  total.num_of_threads = num_of_threads;
+  size_t num_of_failed_files = 0;
+  std::cout << "\t---Done.\n\nRemoved word vectors per file:\n";
+  for (size_t i = 0; i < num_of_files; ++i) {
+    std::cout << "\t\"" << input_files[i] << "\": ";
+    if (file_failed[i]) {
+      std::cout << "FAILED\n";
+      num_of_failed_files++;
+      continue;
+    }
+    std::cout << file_statistics[i].num_of_removed_vectors << " of " << file_statistics[i].num_of_checked_vectors << '\n';
+    AddRunStatistics(file_statistics[i], total);
+  }
+  total.total_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+  std::cout << "\nNumber of removed word vectors = " << total.num_of_removed_vectors << " of " << total.num_of_checked_vectors << " in " << num_of_files-num_of_failed_files << " files";
+  if (num_of_failed_files > 0)
+    std::cout << " (" << num_of_failed_files << " files failed)";
+  std::cout << '\n';
+  for (int i = 0; i < kNumOfTokenRules; ++i) {
+    if (total.num_of_removed_vectors_per_rule[i] > 0)
+      std::cout << '\t' << kTokenRuleNames[i] << ": " << total.num_of_removed_vectors_per_rule[i] << '\n';
+  }
+  if (total.num_of_removed_compounds > 0)
+    std::cout << "\tcompound words: " << total.num_of_removed_compounds << '\n';
+  if (total.num_of_removed_duplicates > 0)
+    std::cout << "\tduplicates: " << total.num_of_removed_duplicates << '\n';
+  for (int i = 0; i < kNumOfCategories; ++i) {
+    if (total.num_of_removed_vectors_per_category[i] > 0)
+      std::cout << '\t' << kCategoryNames[i] << ": " << total.num_of_removed_vectors_per_category[i] << '\n';
+  }
+  if (!options.statistics_file.empty() && WriteRunStatistics(total, std::to_string(num_of_files)+" files", output_directory, options.statistics_file))
+    std::cout << "Run statistics (of all files) written to \"" << options.statistics_file << "\".\n";
+  return num_of_failed_files == 0;
+}
@@ -0,0 +1,151 @@
+// checkpoint.cc
+
+// Copyright 2019 E. Decker
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Checkpoints of a run (see "--checkpoint" and "--resume"). A checkpoint is
+// only saved after the output file has been synced up to its "output_offset",
+// and it replaces the previous one by renaming a synced temporary file, so
+// the checkpoint file always describes a state the output file has reached.
+
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "function_word_vector_killer.h"
+
+namespace {
+
+const char kCheckpointMagic[8] = {'F', 'W', 'V', 'K', 'C', 'K', 'P', 'T'};
+const uint32_t kCheckpointVersion = 1;
+
+// A checkpoint file consists of this record followed by the bits of
+// "RunCheckpoint::function_word_was_removed" (one byte per 8 words).
+struct CheckpointRecord {
+  char magic[8];
+  uint32_t version;
+  uint32_t num_of_function_words;
+  uint64_t input_size;
+  int64_t input_modification_time;
+  uint64_t settings;
+  uint64_t input_offset;
+  uint64_t output_offset;
+  int64_t num_of_read_bytes;
+  int64_t num_of_written_bytes;
+  int64_t num_of_writes;
+  int64_t num_of_checked_vectors;
+  int64_t num_of_removed_vectors;
+  int64_t num_of_removed_compounds;
+  int64_t num_of_removed_vectors_per_rule[kNumOfTokenRules];
+  int64_t num_of_removed_vectors_per_category[kNumOfCategories];
+  uint32_t input_checksum;
+  uint32_t checksum; // of everything before it and the bits behind the record
+};
+static_assert(sizeof(CheckpointRecord) == 240, "the record of a checkpoint must not contain padding");
+
+uint32_t GetChecksum(const CheckpointRecord& record, const std::string& bits) {
+  const uint32_t checksum = crc32(0, reinterpret_cast<const Bytef*>(&record), offsetof(CheckpointRecord, checksum));
+  return crc32(checksum, reinterpret_cast<const Bytef*>(bits.data()), bits.size());
+}
+
+}  // namespace
+
+std::string GetCheckpointFile(const std::string& output_file) {
+  return output_file+".fwvk-checkpoint";
+}
+
+uint32_t GetInputChecksum(const char* input_begin, const char* input_position) {
+// Returns the checksum a checkpoint at "input_position" uses to recognize its
+// input file: the crc32 of the (up to) 64 KB in front of it.
+  const char* begin = std::max(input_begin, input_position-(1 << 16));
+  return crc32(0, reinterpret_cast<const Bytef*>(begin), input_position-begin);
+}
+
+bool SaveCheckpoint(const std::string& checkpoint_file, const RunCheckpoint& checkpoint) {
+// Writes "checkpoint" to a temporary file, syncs it, renames it to
+// "checkpoint_file" and syncs the directory (without that the rename might be
+// lost in a crash, leaving an older checkpoint or none). Returns "false" if
+// that failed (the previous checkpoint is kept then, unless only syncing the
+// directory failed).
+  CheckpointRecord record;
+  memset(&record, 0, sizeof(record));
+  memcpy(record.magic, kCheckpointMagic, sizeof(kCheckpointMagic));
+  record.version = kCheckpointVersion;
+  record.num_of_function_words = checkpoint.function_word_was_removed.size();
+  record.input_size = checkpoint.input_size;
+  record.input_modification_time = checkpoint.input_modification_time;
+  record.settings = checkpoint.settings;
+  record.input_offset = checkpoint.input_offset;
+  record.output_offset = checkpoint.output_offset;
+  const RunStatistics& statistics = checkpoint.statistics;
+  record.num_of_read_bytes = statistics.num_of_read_bytes;
+  record.num_of_written_bytes = statistics.num_of_written_bytes;
+  record.num_of_writes = statistics.num_of_writes;
+  record.num_of_checked_vectors = statistics.num_of_checked_vectors;
+  record.num_of_removed_vectors = statistics.num_of_removed_vectors;
+  record.num_of_removed_compounds = statistics.num_of_removed_compounds;
+  std::copy(statistics.num_of_removed_vectors_per_rule.begin(), statistics.num_of_removed_vectors_per_rule.end(), record.num_of_removed_vectors_per_rule);
+  std::copy(statistics.num_of_removed_vectors_per_category.begin(), statistics.num_of_removed_vectors_per_category.end(), record.num_of_removed_vectors_per_category);
+  record.input_checksum = checkpoint.input_checksum;
+  std::string bits((checkpoint.function_word_was_removed.size()+7)/8, '\0');
+  for (size_t i = 0; i < checkpoint.function_word_was_removed.size(); ++i) {
+    if (checkpoint.function_word_was_removed[i])
+      bits[i/8] |= 1 << (i%8);
+  }
+  record.checksum = GetChecksum(record, bits);
+  const std::string temporary_file = checkpoint_file+".tmp";
+  const int file_descriptor = open(temporary_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (file_descriptor < 0)
+    return false;
+  const bool written = WriteAll(file_descriptor, reinterpret_cast<const char*>(&record), sizeof(record)) && WriteAll(file_descriptor, bits.data(), bits.size()) && fdatasync(file_descriptor) == 0;
+  if (close(file_descriptor) != 0 || !written || rename(temporary_file.c_str(), checkpoint_file.c_str()) != 0) {
+    unlink(temporary_file.c_str());
+    return false;
+  }
+  return SyncDirectoryOf(checkpoint_file);
+}
+
+bool LoadCheckpoint(const std::string& checkpoint_file, RunCheckpoint& checkpoint) {
+// Reads "checkpoint_file" into "checkpoint" and returns "false" if it can't
+// be read or is damaged.
+  const MappedFile file(checkpoint_file);
+  CheckpointRecord record;
+  if (!file.IsMapped() || file.size() < sizeof(record))
+    return false;
+  memcpy(&record, file.data(), sizeof(record));
+  const std::string bits(file.data()+sizeof(record), file.size()-sizeof(record));
+  if (memcmp(record.magic, kCheckpointMagic, sizeof(kCheckpointMagic)) != 0 || record.version != kCheckpointVersion || bits.size() != (record.num_of_function_words+7)/8 || record.checksum != GetChecksum(record, bits))
+    return false;
+  checkpoint.input_size = record.input_size;
+  checkpoint.input_modification_time = record.input_modification_time;
+  checkpoint.settings = record.settings;
+  checkpoint.input_offset = record.input_offset;
+  checkpoint.output_offset = record.output_offset;
+  RunStatistics& statistics = checkpoint.statistics;
+  statistics.num_of_read_bytes = record.num_of_read_bytes;
+  statistics.num_of_written_bytes = record.num_of_written_bytes;
+  statistics.num_of_writes = record.num_of_writes;
+  statistics.num_of_checked_vectors = record.num_of_checked_vectors;
+  statistics.num_of_removed_vectors = record.num_of_removed_vectors;
+  statistics.num_of_removed_compounds = record.num_of_removed_compounds;
+  std::copy(record.num_of_removed_vectors_per_rule, record.num_of_removed_vectors_per_rule+kNumOfTokenRules, statistics.num_of_removed_vectors_per_rule.begin());
+  std::copy(record.num_of_removed_vectors_per_category, record.num_of_removed_vectors_per_category+kNumOfCategories, statistics.num_of_removed_vectors_per_category.begin());
+  checkpoint.input_checksum = record.input_checksum;
+  checkpoint.function_word_was_removed.assign(record.num_of_function_words, false);
+  for (size_t i = 0; i < record.num_of_function_words; ++i)
+    checkpoint.function_word_was_removed[i] = (bits[i/8] >> (i%8)) & 1;
+  return true;
+}
@@ -0,0 +1,119 @@
+// compound_matcher.cc
+
+// Copyright 2019 E. Decker
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+
+#include "function_word_vector_killer.h"
+
+namespace {
+
+// Node 0 of the trie is a dead end (every missing transition leads there), so
+// that a walk needs no special case for it; node 1 is the root.
+const uint32_t kDeadNode = 0;
+const uint32_t kRootNode = 1;
+const uint16_t kNoByteClass = 0;
+const uint16_t kSeparatorClass = 1; // '_' and '-'
+
+}  // namespace
+
+CompoundMatcher::CompoundMatcher(const FunctionWordSet& function_words, const uint16_t selected_categories) : byte_classes_(), num_of_byte_classes_(2) {
+  // Every byte that appears in a selected function word gets a class of its
+  // own (but the separators, which share one), so that a row of the table
+  // only needs a column for each of them.
+  byte_classes_['_'] = byte_classes_['-'] = kSeparatorClass;
+  for (size_t i = 0; i < function_words.size(); ++i) {
+    if ((function_words.category_mask(i) & selected_categories) == 0)
+      continue;
+    for (const unsigned char byte : function_words.word(i)) {
+      if (byte_classes_[byte] == kNoByteClass)
+        byte_classes_[byte] = num_of_byte_classes_++;
+    }
+  }
+  transitions_.assign(2*num_of_byte_classes_, kDeadNode);
+  category_masks_.assign(2, 0);
+  for (size_t i = 0; i < function_words.size(); ++i) {
+    const uint16_t category_mask = function_words.category_mask(i) & selected_categories;
+    const std::string_view word = function_words.word(i);
+    // A walk follows at most one path per separator of the entries (see
+    // "Match()"), so longer entries would overflow its array of paths.
+    if (category_mask == 0 || word.empty() || std::count_if(word.begin(), word.end(), [this](const unsigned char byte) { return byte_classes_[byte] == kSeparatorClass; }) >= (long) kMaxPaths)
+      continue;
+    uint32_t node = kRootNode;
+    for (const unsigned char byte : word) {
+      const size_t transition = node*num_of_byte_classes_+byte_classes_[byte];
+      if (transitions_[transition] == kDeadNode) {
+        transitions_[transition] = category_masks_.size();
+        transitions_.resize(transitions_.size()+num_of_byte_classes_, kDeadNode);
+        category_masks_.push_back(0);
+      }
+      node = transitions_[transition];
+    }
+    category_masks_[node] |= category_mask;
+  }
+}
+
+uint16_t CompoundMatcher::Match(const std::string_view token) const {
+// Returns the categories of the function words a compound "token" (like
+// "as_well_as" or "vis-à-vis") consists of, or 0 if it isn't one. A compound
+// is split at every '_' and '-', and each of its parts has to be a function
+// word - unless several parts together form an entry of the lists (e.g.
+// "vis-à-vis" in "from_vis_à_vis"; '_' and '-' are interchangeable). All ways
+// of splitting the token are followed at once in a single pass over its
+// bytes: a path goes on in the trie at a separator and, if its part so far is
+// a whole function word, a new path starts at the root as well.
+  struct Path {
+    uint32_t node;
+    uint16_t category_mask; // categories of the parts before "node"
+  };
+  std::array<Path, kMaxPaths> paths, next_paths;
+  size_t num_of_paths = 1;
+  paths[0] = {kRootNode, 0};
+  bool has_separator = false;
+  for (const unsigned char byte : token) {
+    const uint16_t byte_class = byte_classes_[byte];
+    size_t num_of_next_paths = 0;
+    auto add_path = [&](const uint32_t node, const uint16_t category_mask) {
+      // Paths that arrive at the same node are merged.
+      for (size_t i = 0; i < num_of_next_paths; ++i) {
+        if (next_paths[i].node == node) {
+          next_paths[i].category_mask |= category_mask;
+          return;
+        }
+      }
+      if (num_of_next_paths < kMaxPaths)
+        next_paths[num_of_next_paths++] = {node, category_mask};
+    };
+    for (size_t i = 0; i < num_of_paths; ++i) {
+      const uint32_t node = paths[i].node;
+      const uint32_t next_node = transitions_[node*num_of_byte_classes_+byte_class];
+      if (next_node != kDeadNode)
+        add_path(next_node, paths[i].category_mask);
+      if (byte_class == kSeparatorClass && category_masks_[node] != 0)
+        add_path(kRootNode, paths[i].category_mask | category_masks_[node]);
+    }
+    if (num_of_next_paths == 0)
+      return 0;
+    has_separator |= byte_class == kSeparatorClass;
+    std::copy(next_paths.begin(), next_paths.begin()+num_of_next_paths, paths.begin());
+    num_of_paths = num_of_next_paths;
+  }
+  uint16_t category_mask = 0;
+  for (size_t i = 0; i < num_of_paths; ++i) {
+    if (category_masks_[paths[i].node] != 0)
+      category_mask |= paths[i].category_mask | category_masks_[paths[i].node];
+  }
+  return (has_separator)? category_mask : 0;
+}
@@ -0,0 +1,139 @@
+// dictionary.cc
+
+// Copyright 2019 E. Decker
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <fstream>
+#include <iostream>
+
+#include "function_word_vector_killer.h"
+
+std::vector<std::string> LoadFunctionWordFile(const std::string& file) {
+// Returns the function words of a txt-file (separated by spaces or newlines)
+// or an empty vector if the file is bad or couldn't be found.
+  if (!FileIsValid(file)) {
+    std::cerr << "\tThose function words couldn't be added to the words to remove.\n";
+    return {};
+  }
+  std::ifstream file_stream(file);
+  std::vector<std::string> words;
+  std::string word;
+  while (file_stream >> word)
+    words.push_back(word);
+  return words;
+}
+
+bool CompileDictionary(const std::string& directory, const std::string& dictionary_file) {
+// Reads the txt-files of all categories in "directory" and writes their words
+// (in lower case, with the categories each word belongs to) as a hash set
+// that can be mapped into memory to "dictionary_file" (see
+// "FunctionWordSet"). Categories without a txt-file are left empty. Returns
+// "false" if no function words were found or writing failed.
+  std::vector<std::string> words;
+  std::vector<uint16_t> category_masks;
+  for (int i = 0; i < kNumOfCategories; ++i) {
+    const std::string file = directory+"/"+kCategoryNames[i]+".txt";
+    if (!std::ifstream(file).is_open()) {
+      std::cout << "\t\"" << file << "\" not found - category " << i+1 << " stays empty.\n";
+      continue;
+    }
+    for (const auto& word : LoadFunctionWordFile(file)) {
+      words.push_back(SetToLowerCase(word));
+      category_masks.push_back(1 << i);
+    }
+  }
+  if (words.empty()) {
+    std::cerr << "ERROR: NO FUNCTION WORDS FOUND IN \"" << directory << "\"!\n";
+    return false;
+  }
+  const FunctionWordSet function_words(words, category_masks);
+  if (!function_words.WriteToFile(dictionary_file))
+    return false;
+  std::cout << "Compiled " << function_words.size() << " function words from \"" << directory << "\" into \"" << dictionary_file << "\".\n";
+  return true;
+}
+
+uint16_t GetCategoryMask(const std::vector<bool>& words_to_remove) {
+// Returns the bit mask of the selected categories (bit i is set if
+// "words_to_remove[i]").
+  uint16_t category_mask = 0;
+  for (unsigned i = 0; i < words_to_remove.size() && i < kNumOfCategories; ++i) {
+    if (words_to_remove[i])
+      category_mask |= 1 << i;
+  }
+  return category_mask;
+}
+
+std::unique_ptr<FunctionWordSet> LoadFunctionWordSet(const std::vector<bool>& words_to_remove, const int language, const KillerOptions& options) {
+// Returns the set of function words to remove or "NULL" if the dictionary
+// file given in "options" can't be used. A compiled dictionary is mapped and
+// used as it is (it contains the words of all categories, so the words of the
+// categories that weren't selected are ignored when they are found).
+// Otherwise the txt-files of the selected categories are loaded from
+// "options.data_directory" or the directory of the "language" - "NULL" is
+// returned as well if one of them can't be read or they contain no words at
+// all (e.g. because the directory is wrong), so that a run doesn't silently
+// remove nothing.
+  std::unique_ptr<FunctionWordSet> function_words;
+  if (!options.dictionary_file.empty()) {
+    function_words.reset(new FunctionWordSet(options.dictionary_file));
+    if (!function_words->IsValid())
+      function_words.reset();
+    return function_words;
+  }
+  const std::string directory = (!options.data_directory.empty())? options.data_directory : (language == 0)? "data/english" : "data/german";
+  const uint16_t selected_categories = GetCategoryMask(words_to_remove);
+  std::vector<std::string> words;
+  std::vector<uint16_t> category_masks;
+  bool all_files_are_read = true;
+  for (int i = 0; i < kNumOfCategories; ++i) {
+    if (selected_categories & (1 << i)) {
+      const std::string file = directory+"/"+kCategoryNames[i]+".txt";
+      if (!FileIsValid(file)) {
+        all_files_are_read = false;
+        continue;
+      }
+      for (const auto& word : LoadFunctionWordFile(file)) {
+        words.push_back(SetToLowerCase(word)); // the words of the input file are compared in lower case
+        category_masks.push_back(1 << i);
+      }
+    }
+  }
+  if (!all_files_are_read || (selected_categories != 0 && words.empty())) {
+    std::cerr << "ERROR: THE FUNCTION WORDS OF THE SELECTED CATEGORIES COULDN'T BE LOADED FROM \"" << directory << "\"!\n";
+    return function_words;
+  }
+  function_words.reset(new FunctionWordSet(words, category_masks));
+  return function_words;
+}
+
+void PrintFunctionWords(const FunctionWordSet& function_words, const uint16_t selected_categories) {
+// Prints the words of every selected category in the same order as they can
+// be found in their txt-file (except for words that are in an earlier
+// category as well).
+  const std::vector<std::string> labels_of_words_to_remove = {"Adpositions:\n\t", "Articles etc. (various pronouns, demonstratives, ...):\n\t", "Conjunctions and subjunctions:\n\t", "Interjections:\n\t", "Interrogative words:\n\t", "Numerals:\n\t", "Particles:\n\t", "Personal pronouns and possessives:\n\t", "Temporal words:\n\t", "Miscellaneous words:\n\t"};
+  for (int i = 0; i < kNumOfCategories; ++i) {
+    if (selected_categories & (1 << i)) {
+      std::cout << labels_of_words_to_remove[i];
+      bool is_first_word = true;
+      for (size_t j = 0; j < function_words.size(); ++j) {
+        if (function_words.category_mask(j) & (1 << i)) {
+          std::cout << ((is_first_word)? "" : ", ") << function_words.word(j);
+          is_first_word = false;
+        }
+      }
+      std::cout << '\n';
+    }
+  }
+}
@@ -0,0 +1,78 @@
+// file_streams.cc
+
+// Copyright 2019 E. Decker
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "function_word_vector_killer.h"
+
+FileInputStream::~FileInputStream() {
+  if (file_descriptor_ != STDIN_FILENO)
+    close(file_descriptor_);
+}
+
+long long FileInputStream::Read(char* data, const size_t size) {
+  while (true) {
+    const ssize_t num_of_read_bytes = read(file_descriptor_, data, size);
+    if (num_of_read_bytes > 0)
+      num_of_consumed_bytes_ += num_of_read_bytes;
+    if (num_of_read_bytes >= 0 || errno != EINTR)
+      return num_of_read_bytes;
+  }
+}
+
+long long GetRewritableOffset(const int file_descriptor) {
+// The header line is written where the file descriptor stands, which isn't
+// the beginning of the file if e.g. the standard output is redirected behind
+// other output. With "O_APPEND" "pwrite()" appends as well (on Linux), so the
+// header line can't be rewritten then.
+  const int flags = fcntl(file_descriptor, F_GETFL);
+  if (flags < 0 || (flags & O_APPEND))
+    return -1;
+  const off_t offset = lseek(file_descriptor, 0, SEEK_CUR);
+  return (offset < 0)? -1 : offset;
+}
+
+FileOutputStream::FileOutputStream(const int file_descriptor, const long long header_offset)
+    : file_descriptor_(file_descriptor),
+      header_offset_(header_offset) {}
+
+FileOutputStream::~FileOutputStream() {
+  Close();
+}
+
+bool FileOutputStream::Write(const char* data, const size_t size) {
+  return WriteAll(file_descriptor_, data, size);
+}
+
+bool FileOutputStream::RewriteHeader(const std::string& header) {
+// Overwrites the header line written at "header_offset_".
+  return header_offset_ >= 0 && pwrite(file_descriptor_, header.data(), header.length(), header_offset_) == (ssize_t) header.length();
+}
+
+bool FileOutputStream::Sync() {
+  return fdatasync(file_descriptor_) == 0;
+}
+
+bool FileOutputStream::Close() {
+  if (file_descriptor_ < 0)
+    return true;
+  const bool closed = close(file_descriptor_) == 0;
+  file_descriptor_ = -1;
+  return closed;
+}
@@ -0,0 +1,187 @@
+// function_word_set.cc
+
+// Copyright 2019 E. Decker
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "function_word_vector_killer.h"
+
+namespace {
+
+// A dictionary file starts with this header and is followed by the tables of
+// the set ("FunctionWordSet::Slot"s, word offsets, category masks and the
+// words themselves) exactly as they are used in memory, so that it can be
+// mapped and searched right away.
+struct DictionaryFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order; // "kByteOrderMark" as written by the compiling machine
+  uint32_t num_of_words;
+  uint32_t num_of_slots;
+  uint32_t arena_size;
+  uint32_t reserved;
+};
+const char kDictionaryMagic[8] = {'F', 'W', 'V', 'K', 'D', 'I', 'C', 'T'};
+const uint32_t kDictionaryVersion = 1; // to be increased whenever the layout or the hash function changes
+const uint32_t kByteOrderMark = 0x01020304;
+static_assert(sizeof(DictionaryFileHeader) == 32, "the header of a dictionary file must not contain padding");
+
+}  // namespace
+
+FunctionWordSet::FunctionWordSet(const std::vector<std::string>& words, const std::vector<uint16_t>& category_masks) : num_of_words_(0) {
+  // Uses at least twice as many slots as there are words (and a power of two,
+  // so that the slot of a hash value can be found by masking it), which keeps
+  // the probe sequences short.
+  size_t num_of_slots = 16;
+  while (num_of_slots < 2*words.size())
+    num_of_slots *= 2;
+  slot_storage_.resize(num_of_slots);
+  word_offset_storage_.push_back(0);
+  for (size_t i = 0; i < words.size(); ++i) {
+    const std::string& word = words[i];
+    const uint16_t category_mask = (i < category_masks.size())? category_masks[i] : 0;
+    const uint64_t hash = Hash(word);
+    size_t slot_index = hash & (num_of_slots-1);
+    bool is_duplicate = false;
+    while (slot_storage_[slot_index].index >= 0) {
+      const Slot& slot = slot_storage_[slot_index];
+      if (slot.hash == static_cast<uint32_t>(hash) && arena_storage_.compare(word_offset_storage_[slot.index], word_offset_storage_[slot.index+1]-word_offset_storage_[slot.index], word) == 0) { // avoids multiple additions of the same word
+        is_duplicate = true;
+        break;
+      }
+      slot_index = (slot_index+1) & (num_of_slots-1);
+    }
+    if (is_duplicate) {
+      category_mask_storage_[slot_storage_[slot_index].index] |= category_mask;
+      continue;
+    }
+    // All words are stored one after another in "arena_storage_" (instead of
+    // in separate strings), so that the whole set fits in a few flat blocks of
+    // memory.
+    slot_storage_[slot_index] = {static_cast<uint32_t>(hash), static_cast<int32_t>(num_of_words_++)};
+    arena_storage_ += word;
+    word_offset_storage_.push_back(arena_storage_.size());
+    category_mask_storage_.push_back(category_mask);
+  }
+  slots_ = slot_storage_.data();
+  num_of_slots_ = slot_storage_.size();
+  word_offsets_ = word_offset_storage_.data();
+  category_masks_ = category_mask_storage_.data();
+  arena_ = arena_storage_.data();
+}
+
+FunctionWordSet::FunctionWordSet(const std::string& dictionary_file)
+    : dictionary_(new MappedFile(dictionary_file, kRandomAccess)),
+      slots_(NULL),
+      num_of_slots_(0),
+      word_offsets_(NULL),
+      category_masks_(NULL),
+      arena_(NULL),
+      num_of_words_(0) {
+  // Only checks that the tables fit into the file and don't point outside of
+  // it; nothing is parsed or copied.
+  const char* data = dictionary_->data();
+  DictionaryFileHeader header;
+  if (!dictionary_->IsMapped() || dictionary_->size() < sizeof(header)) {
+    std::cerr << "ERROR: OPENING \"" << dictionary_file << "\" FAILED! Make sure that the file exists and that the path is correct.\n";
+    return;
+  }
+  memcpy(&header, data, sizeof(header));
+  const uint64_t slots_offset = sizeof(header), word_offsets_offset = slots_offset+(uint64_t) header.num_of_slots*sizeof(Slot), category_masks_offset = word_offsets_offset+((uint64_t) header.num_of_words+1)*sizeof(uint32_t), arena_offset = category_masks_offset+(uint64_t) header.num_of_words*sizeof(uint16_t);
+  if (memcmp(header.magic, kDictionaryMagic, sizeof(kDictionaryMagic)) != 0 || header.version != kDictionaryVersion || header.byte_order != kByteOrderMark) {
+    std::cerr << "ERROR: \"" << dictionary_file << "\" IS NO DICTIONARY FILE OF THIS VERSION! Compile it again with \"--compile-dict\".\n";
+    return;
+  }
+  const bool has_valid_size = header.num_of_slots > header.num_of_words && (header.num_of_slots & (header.num_of_slots-1)) == 0 && arena_offset+header.arena_size == dictionary_->size();
+  const Slot* slots = reinterpret_cast<const Slot*>(data+slots_offset);
+  const uint32_t* word_offsets = reinterpret_cast<const uint32_t*>(data+word_offsets_offset);
+  bool is_consistent = has_valid_size && word_offsets[0] == 0 && word_offsets[header.num_of_words] == header.arena_size;
+  for (uint32_t i = 0; is_consistent && i < header.num_of_words; ++i)
+    is_consistent = word_offsets[i] <= word_offsets[i+1];
+  // "Find()" probes until it reaches an empty slot, so there has to be one.
+  bool has_empty_slot = false;
+  for (uint32_t i = 0; is_consistent && i < header.num_of_slots; ++i) {
+    is_consistent = slots[i].index < (int32_t) header.num_of_words;
+    has_empty_slot |= slots[i].index < 0;
+  }
+  is_consistent &= has_empty_slot;
+  if (!is_consistent) {
+    std::cerr << "ERROR: \"" << dictionary_file << "\" IS DAMAGED! Compile it again with \"--compile-dict\".\n";
+    return;
+  }
+  slots_ = slots;
+  num_of_slots_ = header.num_of_slots;
+  word_offsets_ = word_offsets;
+  category_masks_ = reinterpret_cast<const uint16_t*>(data+category_masks_offset);
+  arena_ = data+arena_offset;
+  num_of_words_ = header.num_of_words;
+}
+
+FunctionWordSet::~FunctionWordSet() {}
+
+bool FunctionWordSet::WriteToFile(const std::string& dictionary_file) const {
+// Writes the set to "dictionary_file" (see the constructor reading it) and
+// returns "false" if that failed.
+  DictionaryFileHeader header = {};
+  memcpy(header.magic, kDictionaryMagic, sizeof(kDictionaryMagic));
+  header.version = kDictionaryVersion;
+  header.byte_order = kByteOrderMark;
+  header.num_of_words = num_of_words_;
+  header.num_of_slots = num_of_slots_;
+  header.arena_size = word_offsets_[num_of_words_];
+  std::ofstream file_stream(dictionary_file, std::ios::binary);
+  file_stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file_stream.write(reinterpret_cast<const char*>(slots_), num_of_slots_*sizeof(Slot));
+  file_stream.write(reinterpret_cast<const char*>(word_offsets_), (num_of_words_+1)*sizeof(uint32_t));
+  file_stream.write(reinterpret_cast<const char*>(category_masks_), num_of_words_*sizeof(uint16_t));
+  file_stream.write(arena_, header.arena_size);
+  file_stream.close();
+  if (file_stream.fail()) {
+    std::cerr << "ERROR: WRITING \"" << dictionary_file << "\" FAILED!\n";
+    return false;
+  }
+  return true;
+}
+
+int FunctionWordSet::Find(const std::string_view word) const {
+// Returns the index of "word" (i.e. a number between 0 and "size()"-1 that is
+// unique for every word in the set) or -1 if "word" is not in the set.
+  const uint64_t hash = Hash(word);
+  size_t slot_index = hash & (num_of_slots_-1);
+  while (slots_[slot_index].index >= 0) {
+    if (SlotHoldsWord(slots_[slot_index], hash, word))
+      return slots_[slot_index].index;
+    slot_index = (slot_index+1) & (num_of_slots_-1);
+  }
+  return -1;
+}
+
+bool FunctionWordSet::SlotHoldsWord(const Slot& slot, const uint64_t hash, const std::string_view word) const {
+// Compares the (cheap) hash values first and only compares the words if they
+// match.
+  return slot.hash == static_cast<uint32_t>(hash) && this->word(slot.index) == word;
+}
+
+uint64_t FunctionWordSet::Hash(const std::string_view word) {
+// FNV-1a hash of "word".
+  uint64_t hash = 14695981039346656037ull;
+  for (const char character : word) {
+    hash ^= static_cast<unsigned char>(character);
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
@@ -14,53 +14,841 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 
+#include <zlib.h>
+
 #ifndef FUNCTIONS_WORD_VECTOR_KILLER_H_SRC_FUNCTIONS_WORD_VECTOR_KILLER_H_
 #define FUNCTIONS_WORD_VECTOR_KILLER_H_SRC_FUNCTIONS_WORD_VECTOR_KILLER_H_
 
 bool FileIsValid(const std::string& file);
 std::string SetToLowerCase(std::string string);
+const char* FindWordEnd(const char* begin, const char* end);
+void FoldCase(const char* begin, const char* end, std::string& folded);
+void FoldCase(const char* begin, const char* end, char* folded);
+bool WriteAll(const int file_descriptor, const char* data, size_t size);
+bool SyncDirectoryOf(const std::string& file);
+
+// Names of the txt-files (without ".txt") of the 10 categories of function
+// words in "data/<language>", in the order of their numbers.
+extern const std::vector<std::string> kCategoryNames;
+const int kNumOfCategories = 10;
+// Rules that remove word vectors by the form of their word instead of by a
+// dictionary (see "TokenClassifier"), in the order of "kTokenRuleNames".
+enum TokenRule { kNumberRule, kOrdinalRule, kPunctuationRule, kUrlRule, kEmailRule, kLengthRule, kNumOfTokenRules };
+extern const std::vector<std::string> kTokenRuleNames;
+std::vector<std::string> LoadFunctionWordFile(const std::string& file);
+bool CompileDictionary(const std::string& directory, const std::string& dictionary_file);
+
+struct VectorFileHeader {
+// Header line of a word vector file written by word2vec or fastText (e.g.
+// "3000000 300") - if there is one.
+  bool is_present = false;
+  bool is_binary = false; // "true" if the word vectors are stored in the binary format of word2vec
+  long long vocab_size = 0;
+  long long dimension = 0;
+  size_t length = 0; // number of bytes of the header line (including the newline)
+};
+VectorFileHeader ReadVectorFileHeader(const char* begin, const char* end);
+std::string FormatVectorFileHeader(const long long vocab_size, const VectorFileHeader& original_header);
+
+template <typename T>
+class BoundedQueue {
+// Queue connecting two threads of a pipeline (e.g. decompressing and
+// filtering). "Push()" blocks while the queue is full, so a fast stage can't
+// run arbitrarily far ahead of a slow one, and "Pop()" blocks while it is
+// empty. After "Close()" "Push()" returns "false" and "Pop()" returns "false"
+// once the queue is empty.
+ public:
+  BoundedQueue(const size_t capacity) : capacity_(capacity), is_closed_(false) {}
+  bool Push(T item) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_full_.wait(lock, [this]() { return items_.size() < capacity_ || is_closed_; });
+    if (is_closed_)
+      return false;
+    items_.push_back(std::move(item));
+    not_empty_.notify_one();
+    return true;
+  }
+  bool Pop(T& item) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_empty_.wait(lock, [this]() { return !items_.empty() || is_closed_; });
+    if (items_.empty())
+      return false;
+    item = std::move(items_.front());
+    items_.pop_front();
+    not_full_.notify_one();
+    return true;
+  }
+  void Close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    is_closed_ = true;
+    not_full_.notify_all();
+    not_empty_.notify_all();
+  }
+
+ private:
+  const size_t capacity_;
+  std::deque<T> items_;
+  bool is_closed_;
+  std::mutex mutex_;
+  std::condition_variable not_full_, not_empty_;
+};
+
+class WorkStealingPool {
+// Runs tasks on several threads. Every thread ("worker") has a queue of its
+// own; a worker whose queue is empty takes tasks from the queues of the
+// others, so that all threads stay busy even if the tasks take very different
+// times (e.g. files of very different sizes).
+ public:
+  WorkStealingPool(const unsigned num_of_threads);
+  void Add(std::function<void()> task);
+  void Run();
+
+ private:
+  struct Worker {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+  std::vector<std::unique_ptr<Worker>> workers_;
+  size_t next_worker_;
+  void Work(const size_t worker_index);
+};
+
+class InputStream {
+// Interface of the sources word vectors can be read from if the input file
+// can't be mapped into memory.
+ public:
+  virtual ~InputStream() {}
+  // Reads up to "size" bytes into "data" and returns their number (0 at the
+  // end of the input and -1 if reading failed).
+  virtual long long Read(char* data, const size_t size) = 0;
+  // Returns the number of bytes read from the underlying file so far (which
+  // is less than the number of bytes returned by "Read()" if the file is
+  // compressed) - used to estimate the remaining time of a run.
+  virtual long long num_of_consumed_bytes() const = 0;
+};
+
+class FileInputStream : public InputStream {
+// Reads a file descriptor (which is closed by the destructor unless it is the
+// standard input).
+ public:
+  FileInputStream(const int file_descriptor) : file_descriptor_(file_descriptor), num_of_consumed_bytes_(0) {}
+  ~FileInputStream();
+  long long Read(char* data, const size_t size) override;
+  long long num_of_consumed_bytes() const override { return num_of_consumed_bytes_; }
+
+ private:
+  const int file_descriptor_;
+  std::atomic<long long> num_of_consumed_bytes_; // read by another thread if the file is decompressed
+};
+
+class GzipInputStream : public InputStream {
+// Decompresses gzip data read from another "InputStream" on a thread of its
+// own, which hands the decompressed data over in blocks.
+ public:
+  GzipInputStream(std::unique_ptr<InputStream> compressed_input, const std::string& already_read_data);
+  ~GzipInputStream();
+  long long Read(char* data, const size_t size) override;
+  long long num_of_consumed_bytes() const override { return compressed_input_->num_of_consumed_bytes(); }
+
+ private:
+  std::unique_ptr<InputStream> compressed_input_;
+  const std::string already_read_data_; // compressed data that was read before the format was detected
+  BoundedQueue<std::vector<char>> blocks_;
+  std::vector<char> current_block_;
+  size_t current_block_position_;
+  std::atomic<bool> failed_;
+  std::thread thread_;
+  void Decompress();
+};
+
+class OutputStream {
+// Interface of the destinations word vectors can be written to. The header
+// line of a word vector file is written separately, so that it can be
+// replaced by a header line of the same length once all word vectors are
+// written (if "CanRewriteHeader()").
+ public:
+  virtual ~OutputStream() {}
+  // Called once the format of the input is known (before anything is written).
+  virtual void SetInputFormat(const VectorFileHeader& header) {}
+  virtual bool WriteHeader(const char* data, const size_t size) { return Write(data, size); }
+  virtual bool Write(const char* data, const size_t size) = 0;
+  virtual bool CanRewriteHeader() const = 0;
+  virtual bool RewriteHeader(const std::string& header) = 0;
+  // Makes everything written so far durable (returns "false" if it can't).
+  virtual bool Sync() { return false; }
+  virtual bool Close() = 0;
+};
+
+// Returns the offset in the file of "file_descriptor" at which an output
+// stream opened on it starts (its current position) or -1 if what is written
+// there can't be overwritten later (pipes, terminals and files opened for
+// appending).
+long long GetRewritableOffset(const int file_descriptor);
+
+class FileOutputStream : public OutputStream {
+// Writes to a file descriptor; the header line is rewritten at
+// "header_offset" (by default the position of the file descriptor when the
+// stream is opened, see "GetRewritableOffset()").
+ public:
+  FileOutputStream(const int file_descriptor) : FileOutputStream(file_descriptor, GetRewritableOffset(file_descriptor)) {}
+  FileOutputStream(const int file_descriptor, const long long header_offset);
+  ~FileOutputStream();
+  bool Write(const char* data, const size_t size) override;
+  bool CanRewriteHeader() const override { return header_offset_ >= 0; }
+  bool RewriteHeader(const std::string& header) override;
+  bool Sync() override;
+  bool Close() override;
+
+ private:
+  int file_descriptor_;
+  const long long header_offset_; // -1 if the header line can't be rewritten
+};
+
+class GzipOutputStream : public OutputStream {
+// Compresses the data written to it on a thread of its own. The header line is
+// stored uncompressed as a gzip member of its own (gzip files may consist of
+// several members), which makes it possible to replace it later.
+ public:
+  GzipOutputStream(const int file_descriptor) : GzipOutputStream(file_descriptor, GetRewritableOffset(file_descriptor)) {}
+  GzipOutputStream(const int file_descriptor, const long long header_offset); // see "FileOutputStream"
+  ~GzipOutputStream();
+  bool WriteHeader(const char* data, const size_t size) override;
+  bool Write(const char* data, const size_t size) override;
+  bool CanRewriteHeader() const override { return header_offset_ >= 0; }
+  bool RewriteHeader(const std::string& header) override;
+  bool Close() override;
+
+ private:
+  int file_descriptor_;
+  const long long header_offset_;
+  size_t header_member_size_;
+  BoundedQueue<std::vector<char>> blocks_;
+  std::vector<char> current_block_;
+  std::atomic<bool> failed_;
+  std::thread thread_;
+  void Compress();
+  static std::string CompressHeader(const char* data, const size_t size);
+};
+
+bool IsGzipCompressed(const char* data, const size_t size);
+
+// A matrix file (see "--matrix") starts with this header, which is followed
+// (at "data_offset") by the values of the word vectors as a packed row-major
+// matrix of "num_of_rows" x "dimension" little-endian float32 or float16
+// values, so that it can be mapped and used right away. The words of the rows
+// are written to a vocab file of their own (one word per line).
+struct MatrixFileHeader {
+  char magic[8]; // "FWVKMTRX"
+  uint32_t version;
+  uint32_t byte_order; // 0x01020304 as written by the converting machine
+  uint64_t num_of_rows;
+  uint64_t dimension;
+  uint32_t value_size; // 4 (float32) or 2 (float16)
+  uint32_t data_offset;
+  char reserved[24];
+};
+
+class MatrixOutputStream : public OutputStream {
+// Parses the word vectors written to it (lines of a text file or vectors of a
+// word2vec binary file) and writes their values to the "matrix" file and their
+// words to the "vocab" file (see "MatrixFileHeader"). Every word vector has to
+// have the dimension given in the header line (or, if there is none, the
+// dimension of the first word vector); otherwise writing fails.
+ public:
+  MatrixOutputStream(std::unique_ptr<OutputStream> matrix, std::unique_ptr<OutputStream> vocab, const std::string& matrix_file, const bool use_float16);
+  ~MatrixOutputStream();
+  void SetInputFormat(const VectorFileHeader& header) override { input_format_ = header; }
+  bool WriteHeader(const char* data, const size_t size) override { return true; } // the dimension is taken from "SetInputFormat()"
+  bool Write(const char* data, const size_t size) override;
+  bool CanRewriteHeader() const override { return true; }
+  bool RewriteHeader(const std::string& header) override { return true; } // the number of rows is set when closing
+  bool Close() override;
+
+ private:
+  std::unique_ptr<OutputStream> matrix_, vocab_;
+  const std::string matrix_file_;
+  const bool use_float16_;
+  VectorFileHeader input_format_;
+  std::string pending_; // incomplete word vector left from the last "Write()"
+  std::vector<float> values_;
+  std::vector<char> matrix_buffer_, vocab_buffer_;
+  uint64_t num_of_rows_;
+  bool failed_, is_closed_;
+  size_t ParseVectors(const char* begin, const char* end, const bool is_end_of_input);
+  bool AddRow(const char* word_begin, const char* word_end);
+  bool FlushBuffers();
+};
+
+std::string GetShardFile(const std::string& output_file, const size_t index, const size_t num_of_shards);
+
+class ShardedOutputStream : public OutputStream {
+// Splits the word vectors written to it among several shards: in turns (a
+// block of about "block_size" bytes at a time) or by a hash of their word, so
+// that a word always ends up in the same shard. Every shard gets a header
+// line with its own number of word vectors (if the input has a header line),
+// and a manifest (JSON) lists the shards with their number of word vectors,
+// size and crc32 once all of them are complete.
+ public:
+  ShardedOutputStream(std::vector<std::unique_ptr<OutputStream>> shards, const std::vector<std::string>& shard_files, const std::string& manifest_file, const bool shard_by_hash, const size_t block_size);
+  ~ShardedOutputStream();
+  void SetInputFormat(const VectorFileHeader& header) override { input_format_ = header; }
+  bool WriteHeader(const char* data, const size_t size) override;
+  bool Write(const char* data, const size_t size) override;
+  bool CanRewriteHeader() const override;
+  bool RewriteHeader(const std::string& header) override { return true; } // every shard gets a header line of its own when closing
+  bool Close() override;
+
+ private:
+  struct Shard {
+    std::unique_ptr<OutputStream> output;
+    std::string file;
+    std::vector<char> buffer;
+    long long num_of_vectors = 0;
+    uint64_t num_of_bytes = 0; // written so far
+    uint64_t num_of_bytes_in_block = 0; // since it became the current shard
+    uint32_t checksum = 0; // crc32 of the bytes written so far (but the header line)
+  };
+  const std::string manifest_file_;
+  const bool shard_by_hash_;
+  const size_t block_size_;
+  std::vector<Shard> shards_;
+  size_t current_shard_;
+  std::string header_; // as written first (empty if there is no header line)
+  VectorFileHeader input_format_;
+  std::string pending_; // incomplete word vector left from the last "Write()"
+  bool failed_, is_closed_;
+  size_t SplitVectors(const char* begin, const char* end, const bool is_end_of_input);
+  void AddVector(const char* begin, const char* word_end, const char* end);
+  void FlushShard(Shard& shard);
+  bool WriteManifest() const;
+};
+
+class RangeWriter {
+// Class to write ranges of memory (e.g. the kept lines of a mapped input
+// file) to an "OutputStream". Ranges that directly follow each other are
+// written at once, in pieces of at most "max_write_size" bytes.
+ public:
+  RangeWriter(OutputStream& output, const size_t max_write_size);
+  void Write(const char* begin, const char* end);
+  bool Flush();
+  const char* pending_range_end() const { return pending_range_end_; }
+  long long num_of_written_bytes() const { return num_of_written_bytes_; }
+  long long num_of_writes() const { return num_of_writes_; }
+  double write_seconds() const { return write_seconds_; } // time spent in "OutputStream::Write()"
+
+ private:
+  OutputStream& output_;
+  const size_t max_write_size_;
+  const char* pending_range_begin_;
+  const char* pending_range_end_;
+  long long num_of_written_bytes_;
+  long long num_of_writes_;
+  double write_seconds_;
+  bool failed_;
+};
+
+struct ByteRange {
+  uint64_t begin;
+  uint64_t end;
+};
+
+class KeptRangeCollector : public OutputStream {
+// "OutputStream" that doesn't write anything but collects the ranges of the
+// mapped input file between "begin" and "end" that would have been written
+// (used to compact a file in place, see "CompactFileInPlace()").
+ public:
+  KeptRangeCollector(const char* begin, const char* end) : begin_(begin), end_(end), appends_newline_(false) {}
+  bool Write(const char* data, const size_t size) override;
+  bool CanRewriteHeader() const override { return true; }
+  bool RewriteHeader(const std::string& header) override { header_ = header; return true; }
+  bool Close() override { return true; }
+  const std::vector<ByteRange>& kept_ranges() const { return kept_ranges_; }
+  const std::string& header() const { return header_; } // empty if the header line wasn't rewritten
+  bool appends_newline() const { return appends_newline_; }
+
+ private:
+  const char* const begin_;
+  const char* const end_;
+  std::vector<ByteRange> kept_ranges_;
+  std::string header_;
+  bool appends_newline_;
+};
+
+std::string GetJournalFile(const std::string& file);
+bool InPlaceCompactionIsInterrupted(const std::string& file);
+bool CompactFileInPlace(const std::string& file, const char* data, const size_t size, const std::vector<ByteRange>& kept_ranges, const std::string& final_header, const bool append_newline, const size_t block_size, long long& num_of_moved_bytes);
+bool FinishInPlaceCompaction(const std::string& file, const bool roll_back, long long& num_of_moved_bytes);
+
+// How a "MappedFile" is read, which tells the kernel whether reading ahead
+// pays off.
+enum MappedFileAccess { kSequentialAccess, kRandomAccess };
+
+class MappedFile {
+// Class to map a regular file read-only into memory so that its content can be
+// scanned in place instead of being copied line by line into strings. If the
+// file can't be mapped (e.g. because it is a pipe) "IsMapped()" returns
+// "false" and the caller has to fall back to reading it as a stream.
+ public:
+  MappedFile(const std::string& file, const MappedFileAccess access = kSequentialAccess);
+  ~MappedFile();
+  bool IsMapped() const { return data_ != NULL; }
+  const char* data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  const char* data_;
+  size_t size_;
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+};
+
+class TokenClassifier {
+// Class to check the words of the word vectors against all enabled token
+// rules at once: the rules (but the length rule) are combined into a single
+// table-driven automaton that reads every byte of a word exactly once.
+ public:
+  // "enabled_rules" is a bit mask of "TokenRule"s; a word matches the length
+  // rule if it has less than "min_length" or more than "max_length" (if not
+  // 0) characters.
+  TokenClassifier(const uint8_t enabled_rules, const size_t min_length = 0, const size_t max_length = 0);
+  uint8_t Classify(const std::string_view token) const;
+  bool IsEnabled() const { return enabled_rules_ != 0; }
+
+ private:
+  const uint8_t enabled_rules_;
+  const size_t min_length_, max_length_;
+  std::array<uint8_t, 256> byte_classes_; // bytes that are treated alike share a class
+  size_t num_of_byte_classes_;
+  std::vector<uint16_t> transitions_; // next state for every state and byte class
+  std::vector<uint8_t> accepting_rules_; // bit mask of the rules every state matches
+};
+
+class FunctionWordSet;
+
+class WordFingerprintSet {
+// Class to find words that occurred before (see "--dedup"). Only a 64-bit
+// fingerprint and the position of every word are stored; the words are read
+// from the "source" they were found in (e.g. the mapped input file) to
+// compare them if their fingerprints are equal. Without a source (e.g. if the
+// input is read as a stream) a copy of every word is kept instead.
+ public:
+  WordFingerprintSet(const char* source_begin = NULL, const char* source_end = NULL);
+  static uint64_t Fingerprint(const std::string_view word);
+  bool Insert(const std::string_view word, const uint64_t fingerprint);
+  size_t size() const { return num_of_words_; }
+
+ private:
+  struct Slot {
+    uint64_t fingerprint = 0; // 0 if the slot is empty
+    uint64_t position = 0; // of the word in the source or in "arena_"
+  };
+  const char* const source_begin_;
+  const char* const source_end_;
+  std::vector<Slot> slots_;
+  std::string arena_; // copies of the words (each followed by a newline) if there is no source
+  size_t num_of_words_;
+  std::string_view WordAt(const uint64_t position) const;
+  void Grow();
+};
+
+class CompoundMatcher {
+// Class to find compound words (like "as_well_as", "der_die_das" or
+// "vis_à_vis") that consist of function words joined by '_' or '-'. The
+// selected function words are compiled into a trie (a table with a row per
+// node and a column per byte class), which is walked once over the bytes of a
+// word (see "Match()"), so matching doesn't get slower with longer lists.
+ public:
+  CompoundMatcher(const FunctionWordSet& function_words, const uint16_t selected_categories);
+  uint16_t Match(const std::string_view token) const;
+
+ private:
+  static const size_t kMaxPaths = 8; // entries with more separators are left out
+  std::array<uint16_t, 256> byte_classes_;
+  size_t num_of_byte_classes_;
+  std::vector<uint32_t> transitions_; // next node for every node and byte class
+  std::vector<uint16_t> category_masks_; // categories of the function word ending at every node (0 if none does)
+};
+
+// Which word vector of a word that occurs several times in a file is kept
+// (see "--dedup").
+enum DuplicateHandling { kKeepAllOccurrences, kKeepFirstOccurrence, kKeepLastOccurrence };
+
+struct KillerOptions {
+// Options of a run (besides the selected categories of function words).
+  unsigned num_of_threads = 1; // number of threads classifying the lines of a mapped input file
+  // If "true" a function word is only removed at its first occurrence in the
+  // input file and every further word vector of it is kept.
+  bool remove_only_first_occurrence = false;
+  bool compress_output = false; // "true" if the output file shall be gzip compressed
+  // Size of the blocks a streamed input file is read in and maximum size of
+  // a single write to the output file. Sizes between 64 KB and 16 MB ran
+  // equally fast on plain and gzip compressed files piped into the program,
+  // so the default only keeps the number of system calls low.
+  size_t buffer_size = 1 << 22;
+  double progress_interval = 0; // seconds between two progress lines (0 = no progress lines)
+  std::string statistics_file; // if not empty the "RunStatistics" are written to it as JSON
+  std::string data_directory; // directory of the txt-files of the function words (default = "data/<language>")
+  std::string dictionary_file; // if not empty this compiled dictionary is used instead of the txt-files
+  // If "true" the word vectors are removed from the input file itself (which
+  // must be an uncompressed regular file) instead of writing an output file.
+  bool in_place = false;
+  // If "true" the kept word vectors are written as a matrix file and a vocab
+  // file (see "MatrixOutputStream") instead of as they are.
+  bool write_matrix = false;
+  bool use_float16 = false; // "true" if the matrix shall hold float16 instead of float32 values
+  // Bit mask of the "TokenRule"s whose word vectors are removed as well (the
+  // number rule is always used if the numerals are selected). The length
+  // rule removes words with less than "min_word_length" or more than
+  // "max_word_length" (if not 0) characters.
+  uint8_t token_rules = 0;
+  size_t min_word_length = 0;
+  size_t max_word_length = 0;
+  // If "true" compound words whose parts are all function words (see
+  // "CompoundMatcher") are removed as well - at every occurrence.
+  bool match_compounds = false;
+  // Word vectors of words that occur several times (compared as they are,
+  // i.e. case sensitive) are removed but the first or the last one. Keeping
+  // the last one needs a mapped input file. Word vectors of function words
+  // are left to "remove_only_first_occurrence".
+  DuplicateHandling duplicate_handling = kKeepAllOccurrences;
+  // Seconds between two checkpoints of a run (0 = no checkpoints), which
+  // need a mapped input file and an uncompressed regular output file. If
+  // "resume" is "true" the run continues from the checkpoint of the output
+  // file (if there is one).
+  double checkpoint_interval = 0;
+  bool resume = false;
+  // If "num_of_shards" is greater than 1 the kept word vectors are split
+  // among that many output files (see "ShardedOutputStream"), in turns or by
+  // a hash of their word.
+  size_t num_of_shards = 1;
+  bool shard_by_hash = false;
+};
+
+struct RunStatistics {
+// Counters and timers of a run of the "Killer". The times of looking up words
+// and checking the token rules are only measured if a "statistics_file" is given
+// (and are added up over all threads, so they can exceed "total_seconds").
+  std::string input_format; // "text" or "binary" (word2vec)
+  bool input_is_compressed = false;
+  unsigned num_of_threads = 0;
+  size_t buffer_size = 0;
+  long long num_of_read_bytes = 0; // (decompressed) bytes of the input file
+  long long num_of_written_bytes = 0; // (uncompressed) bytes of word vectors written to the output file
+  long long num_of_writes = 0;
+  long long num_of_checked_vectors = 0;
+  long long num_of_removed_vectors = 0;
+  // Word vectors removed by a token rule (a word that matches several rules
+  // is counted in each of them).
+  std::array<long long, kNumOfTokenRules> num_of_removed_vectors_per_rule = {};
+  long long num_of_removed_compounds = 0; // also counted in the categories of their parts
+  long long num_of_removed_duplicates = 0;
+  // Word vectors removed because their word is in a category (a word in
+  // several selected categories is counted in each of them).
+  std::array<long long, kNumOfCategories> num_of_removed_vectors_per_category = {};
+  double lookup_seconds = 0;
+  double token_rule_seconds = 0;
+  double write_seconds = 0; // writing (or handing data over to the compressing thread) and closing the output file
+  double total_seconds = 0;
+};
+std::string QuoteJsonString(const std::string& string);
+void AddRunStatistics(const RunStatistics& statistics, RunStatistics& sum);
+
+struct RunCheckpoint {
+// State of a run that is saved from time to time (see "--checkpoint"), so
+// that an interrupted run can be resumed: the input file has been checked up
+// to "input_offset" and the output file has been written and synced up to
+// "output_offset".
+  uint64_t input_size = 0;
+  int64_t input_modification_time = 0; // in nanoseconds
+  uint32_t input_checksum = 0; // see "GetInputChecksum()"
+  uint64_t settings = 0; // fingerprint of the settings of the run that change the output
+  uint64_t input_offset = 0;
+  uint64_t output_offset = 0;
+  RunStatistics statistics; // only the counters are saved
+  std::vector<bool> function_word_was_removed;
+};
+std::string GetCheckpointFile(const std::string& output_file);
+uint32_t GetInputChecksum(const char* input_begin, const char* input_position);
+bool SaveCheckpoint(const std::string& checkpoint_file, const RunCheckpoint& checkpoint);
+bool LoadCheckpoint(const std::string& checkpoint_file, RunCheckpoint& checkpoint);
+bool WriteRunStatistics(const RunStatistics& statistics, const std::string& input_file, const std::string& output_file, const std::string& statistics_file);
+
+class ProgressReporter {
+// Prints a line with the progress of a run (read megabytes, checked word
+// vectors, throughput and - if the size of the input file is known - the
+// estimated remaining time) to the standard error output every "interval"
+// seconds. On a terminal the line is overwritten every time.
+ public:
+  ProgressReporter(const double interval, const long long input_size);
+  void Update(const long long num_of_consumed_bytes, const long long num_of_read_bytes, const long long num_of_checked_vectors);
+  void Finish();
+
+ private:
+  const double interval_;
+  const long long input_size_; // -1 if unknown
+  const std::chrono::steady_clock::time_point start_;
+  const bool is_terminal_;
+  double next_report_; // seconds since "start_"
+  bool has_reported_;
+};
+
+bool CollectInputFiles(const std::vector<std::string>& patterns, const std::string& list_file, std::vector<std::string>& input_files);
+bool RunBatch(const std::vector<std::string>& input_files, const std::string& output_directory, const std::vector<bool>& words_to_remove, const int language, const KillerOptions& options);
+uint16_t GetCategoryMask(const std::vector<bool>& words_to_remove);
+std::unique_ptr<FunctionWordSet> LoadFunctionWordSet(const std::vector<bool>& words_to_remove, const int language, const KillerOptions& options);
+void PrintFunctionWords(const FunctionWordSet& function_words, const uint16_t selected_categories);
+uint8_t GetTokenRules(const uint16_t selected_categories, const KillerOptions& options);
+
+// The classes "WordFilter", "VectorFilter" and "CallbackOutputStream" are the
+// interface of the library ("make lib") for programs that remove function
+// words while they load word vectors themselves, e.g.:
+//
+//   const WordFilter word_filter(data_directory+"/english", (1 << kNumOfCategories)-1); // all English function words
+//   if (word_filter.Removes("the")) ...
+//   CallbackOutputStream kept_vectors([&](const char* data, const size_t size) { return ParseVectors(data, size); });
+//   VectorFilter vector_filter(word_filter, kept_vectors);
+//   vector_filter.Filter(input_stream); // or piece by piece: "Filter(data, size)"
+//   vector_filter.Finish();
+//
+// A "WordFilter" can be shared by any number of threads; every thread needs a
+// "VectorFilter" of its own.
+
+struct WordMatch {
+// Why a word is removed (see "WordFilter::Classify()").
+  uint8_t matched_rules = 0; // bit mask of the "TokenRule"s it matches
+  int function_word_index = -1; // index in "WordFilter::function_words()" (-1 if it isn't a function word)
+  uint16_t compound_categories = 0; // categories of the parts if it is a compound of function words
+  bool IsMatch() const { return matched_rules != 0 || function_word_index >= 0 || compound_categories != 0; }
+};
+
+class WordFilter {
+// Class to decide whether a word is removed: the function words of the
+// selected categories (a bit mask, bit i = category i of "kCategoryNames"),
+// the words matching the token rules and (if "options.match_compounds") the
+// compounds of function words. It is built once and only read from then on.
+ public:
+  // Loads the function words from the txt-files in "data_directory" (e.g.
+  // "data/english" of this repository, wherever it is installed) - or from
+  // "options.dictionary_file" if one is given (see "--compile-dict").
+  // "IsValid()" returns "false" if that failed.
+  WordFilter(const std::string& data_directory, const uint16_t category_mask, const KillerOptions& options = KillerOptions());
+  // Uses "function_words" (which must outlive the filter), so that they can
+  // be loaded once for several filters.
+  WordFilter(const FunctionWordSet& function_words, const uint16_t category_mask, const KillerOptions& options = KillerOptions());
+  ~WordFilter();
+  bool IsValid() const { return function_words_ != NULL; }
+  const FunctionWordSet& function_words() const { return *function_words_; }
+  uint16_t selected_categories() const { return selected_categories_; }
+  // The following functions expect a word in lower case (see "FoldCase()").
+  uint8_t MatchTokenRules(const std::string_view folded_word) const { return token_classifier_.Classify(folded_word); }
+  int FindFunctionWord(const std::string_view folded_word) const;
+  uint16_t MatchCompound(const std::string_view folded_word) const { return (compound_matcher_)? compound_matcher_->Match(folded_word) : 0; }
+  WordMatch Classify(const std::string_view folded_word) const;
+  // Takes a word as it is (in any case) and allocates no memory.
+  bool Removes(const std::string_view token) const;
+
+ private:
+  static const size_t kMaxFoldedTokenLength = 256;
+  std::unique_ptr<FunctionWordSet> loaded_function_words_; // "NULL" unless loaded by the filter itself
+  const FunctionWordSet* function_words_;
+  const uint16_t selected_categories_;
+  const TokenClassifier token_classifier_;
+  std::unique_ptr<const CompoundMatcher> compound_matcher_; // "NULL" unless "options.match_compounds"
+  WordFilter(const WordFilter&) = delete;
+  WordFilter& operator=(const WordFilter&) = delete;
+};
+
+class CallbackOutputStream : public OutputStream {
+// "OutputStream" that hands everything written to it to a function, e.g. to
+// parse the kept word vectors of a "VectorFilter" while they are loaded. The
+// data is only valid during the call. Every call gets whole word vectors (the
+// header line - if there is one - comes first and on its own; only the
+// newline of an unterminated last line follows separately). The function
+// returns "false" to stop the filter.
+ public:
+  typedef std::function<bool(const char* data, const size_t size)> Callback;
+  CallbackOutputStream(Callback callback) : callback_(std::move(callback)) {}
+  bool Write(const char* data, const size_t size) override { return callback_(data, size); }
+  bool CanRewriteHeader() const override { return false; }
+  bool RewriteHeader(const std::string& header) override { return false; }
+  bool Close() override { return true; }
+
+ private:
+  Callback callback_;
+};
+
+class VectorFilter {
+// Class to remove the word vectors whose word a "WordFilter" matches from
+// word vector data (text or word2vec binary, with or without header line)
+// and to write the others to an "OutputStream". The data can be passed in
+// pieces of any size as it is read (or as a whole stream); the complete word
+// vectors are classified whenever "options.buffer_size" bytes are buffered
+// and once more by "Finish()". The header line is passed on as it is (see
+// "statistics()" for the number of removed word vectors). Input that is in
+// memory as a whole (e.g. a mapped file) can be filtered at once on several
+// threads with "FilterMapped()" instead, which is what the "Killer" does.
+ public:
+  typedef std::function<void()> ChunkCallback;
+  VectorFilter(const WordFilter& word_filter, OutputStream& output, const KillerOptions& options = KillerOptions());
+  ~VectorFilter();
+  bool Filter(const char* data, size_t size);
+  bool Filter(InputStream& input, ProgressReporter* progress = NULL);
+  bool Filter(std::istream& stream);
+  bool Finish();
+  bool FilterMapped(const char* data, const size_t size, const RunCheckpoint* resume_state = NULL, const ChunkCallback& chunk_written = nullptr);
+  bool GetState(RunCheckpoint& state);
+  const VectorFileHeader& header() const { return header_; } // read from the first block
+  const RunStatistics& statistics() const { return statistics_; }
+  bool failed() const { return failed_; }
+
+ private:
+  struct LineRange {
+  // Range of word vectors (i.e. lines of a text file) of the input that shall
+  // be written to the output file - unless "function_word_index" is not -1:
+  // then the range is a single word vector whose word is the function word
+  // with that index (which is only removed at its first occurrence). If
+  // duplicates are removed, every kept word vector is a range of its own with
+  // the "fingerprint" of its word.
+    const char* begin;
+    const char* end;
+    int function_word_index;
+    uint64_t fingerprint = 0;
+    bool is_duplicate = false; // set by "MarkDuplicates()"
+  };
+  struct Chunk {
+  // Result of classifying a part of the input that consists of complete word
+  // vectors.
+    std::vector<LineRange> line_ranges;
+    int num_of_checked_vectors = 0;
+    int num_of_removed_vectors = 0;
+    std::array<int, kNumOfTokenRules> num_of_removed_vectors_per_rule = {};
+    int num_of_removed_compounds = 0;
+    int num_of_removed_duplicates = 0;
+    std::array<int, kNumOfCategories> num_of_removed_vectors_per_category = {};
+    double lookup_seconds = 0;
+    double token_rule_seconds = 0;
+    bool is_classified = false;
+  };
+  const WordFilter& word_filter_;
+  OutputStream& output_;
+  const KillerOptions options_;
+  VectorFileHeader header_;
+  std::unique_ptr<RangeWriter> writer_;
+  uint64_t writer_offset_; // position in the output at which "writer_" started writing
+  std::vector<char> buffer_;
+  size_t buffer_fill_;
+  bool header_was_read_, is_finished_, failed_;
+  std::vector<bool> function_word_was_removed_;
+  std::unique_ptr<WordFingerprintSet> seen_words_; // "NULL" unless duplicates are removed
+  RunStatistics statistics_;
+  bool CanStream();
+  void FilterBuffer(const bool is_end_of_input);
+  bool FinishWriting(const bool last_line_is_unterminated);
+  void ClassifyChunk(const char* chunk_begin, const char* chunk_end, Chunk& chunk) const;
+  void MarkDuplicates(Chunk& chunk, WordFingerprintSet& seen_words, const bool backwards) const;
+  void WriteChunk(const Chunk& chunk);
+  template <size_t kSize>
+  static void CountMatches(const uint16_t mask, std::array<int, kSize>& counts);
+  const char* FindEndOfVector(const char* vector_begin, const char* end, const bool is_end_of_input) const;
+  static const char* GetWord(const char* line_begin, const char* line_end, std::string& word);
+  VectorFilter(const VectorFilter&) = delete;
+  VectorFilter& operator=(const VectorFilter&) = delete;
+};
 
 class Killer {
 // Class to collect the words that shall be removed and to store them in a
-// binary tree (see the class "BinaryTree"). It will be checked whether the
+// hash set (see the class "FunctionWordSet"). It will be checked whether the
 // words to remove are contained in the "input_file" and if so they and their
-// vectors won't be written to the "output_file".
+// vectors won't be written to the "output_file". The word vectors are
+// classified by a "VectorFilter"; the "Killer" adds what is needed for files.
  public:
-  Killer(const std::string& input_file, const std::string& output_file, const std::vector<bool>& words_to_remove, const int language);
+  Killer(const std::string& input_file, const std::string& output_file, const std::vector<bool>& words_to_remove, const int language, const KillerOptions& options = KillerOptions());
+  Killer(const std::string& input_file, const std::string& output_file, const std::vector<bool>& words_to_remove, const FunctionWordSet& function_words_to_remove, const KillerOptions& options = KillerOptions());
   ~Killer();
+  const RunStatistics& statistics() const { return statistics_; }
+  bool failed() const { return failed_; } // "true" if a file couldn't be read or written
 
  private:
   const std::string input_file_, output_file_;
   const std::vector<bool> words_to_remove_;
-  const int language_;
-  void SelectAndRemoveWords();
-  std::vector<std::string> LoadFunctionWords(const int index);
-  std::vector<std::string> GetWordsFromALine(const std::string& line);
-  bool IsNumber(const std::string& word);
+  const KillerOptions options_;
+  const uint16_t selected_categories_; // bit i is set if "words_to_remove_[i]"
+  std::unique_ptr<const WordFilter> word_filter_; // built from the function words of the run
+  VectorFileHeader header_;
+  RunStatistics statistics_;
+  bool failed_;
+  void SelectAndRemoveWords(const int language);
+  void RemoveWords(const FunctionWordSet& function_words_to_remove);
+  void CompactInputFile(const MappedFile& input, const bool is_mapped, const FunctionWordSet& function_words_to_remove);
+  void FilterMappedFile(const MappedFile& input, const FunctionWordSet& function_words_to_remove, OutputStream& output, const RunCheckpoint* resumed_checkpoint = NULL);
+  void FilterFileStream();
+  bool LoadValidCheckpoint(const MappedFile& input, const FunctionWordSet& function_words_to_remove, RunCheckpoint& checkpoint);
+  bool SaveRunCheckpoint(const MappedFile& input, const FunctionWordSet& function_words_to_remove, VectorFilter& filter) const;
+  uint64_t GetSettingsFingerprint(const FunctionWordSet& function_words_to_remove) const;
+  std::unique_ptr<OutputStream> OpenOutputFile(const long long resume_offset = -1) const;
+  std::unique_ptr<OutputStream> OpenShardFiles() const;
+  void FinishOutputFile(OutputStream& output, const bool header_is_final, const bool write_failed);
 };
 
-class BinaryTree {
-// Class to store the words that shall be removed in a binary tree.
+class FunctionWordSet {
+// Class to store the words that shall be removed in a read-only hash set. It
+// is built once from all selected function words (or mapped from a dictionary
+// file compiled with "WriteToFile()") and can then be searched by several
+// threads at the same time without allocating any memory.
  public:
-  BinaryTree();
-  ~BinaryTree();
-  void AddWord(const std::string& word_to_add);
-  bool RemoveWord(const std::string& word_to_remove);
+  // "category_masks" (if not empty) holds a bit mask of the categories of
+  // every word in "words" (bit i = category i); the masks of duplicate words
+  // are combined.
+  FunctionWordSet(const std::vector<std::string>& words, const std::vector<uint16_t>& category_masks = {});
+  // Maps a dictionary file; if it can't be used "IsValid()" returns "false".
+  FunctionWordSet(const std::string& dictionary_file);
+  ~FunctionWordSet();
+  bool IsValid() const { return slots_ != NULL; }
+  bool WriteToFile(const std::string& dictionary_file) const;
+  int Find(const std::string_view word) const;
+  bool Contains(const std::string_view word) const { return Find(word) >= 0; }
+  std::string_view word(const int index) const { return std::string_view(arena_+word_offsets_[index], word_offsets_[index+1]-word_offsets_[index]); }
+  uint16_t category_mask(const int index) const { return category_masks_[index]; }
+  size_t size() const { return num_of_words_; }
 
  private:
-  struct WordItem {
-    std::string word = "DEFAULT";
-    WordItem* left;
-    WordItem* right;
-    WordItem(std::string str) : word(str), left(NULL), right(NULL) {}
+  struct Slot {
+    uint32_t hash = 0; // lower half of the hash value of the word
+    int32_t index = -1; // -1 if the slot is empty
   };
-  WordItem* root_;
-  void DestroyTree(WordItem* current_word_item);
-  void RemoveWordItem(WordItem* previous_word_item, WordItem* word_item_to_delete, const int side);
-  void RemoveWordItemThatHasTwoChildren(WordItem* word_item_to_delete);
+  // The tables are either stored in the "*_storage_" members or in the
+  // mapped "dictionary_"; the pointers below point to the one in use.
+  std::vector<Slot> slot_storage_;
+  std::vector<uint32_t> word_offset_storage_;
+  std::vector<uint16_t> category_mask_storage_;
+  std::string arena_storage_; // all words one after another
+  std::unique_ptr<MappedFile> dictionary_;
+  const Slot* slots_;
+  size_t num_of_slots_;
+  const uint32_t* word_offsets_; // position of every word (and the end of the last one) in "arena_"
+  const uint16_t* category_masks_; // by index of the word
+  const char* arena_;
+  size_t num_of_words_;
+  bool SlotHoldsWord(const Slot& slot, const uint64_t hash, const std::string_view word) const;
+  static uint64_t Hash(const std::string_view word);
+  FunctionWordSet(const FunctionWordSet&) = delete;
+  FunctionWordSet& operator=(const FunctionWordSet&) = delete;
 };
 
 #endif // FUNCTIONS_WORD_VECTOR_KILLER_H_SRC_FUNCTIONS_WORD_VECTOR_KILLER_H_
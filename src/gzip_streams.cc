@@ -0,0 +1,220 @@
+// gzip_streams.cc
+
+// Copyright 2019 E. Decker
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cstring>
+
+#include <unistd.h>
+
+#include "function_word_vector_killer.h"
+
+namespace {
+
+const size_t kBlockSize = 1 << 20; // size of the blocks handed over between the threads
+const size_t kNumOfQueuedBlocks = 8;
+
+}  // namespace
+
+bool IsGzipCompressed(const char* data, const size_t size) {
+// Checks the magic bytes every gzip file starts with.
+  return size >= 2 && static_cast<unsigned char>(data[0]) == 0x1f && static_cast<unsigned char>(data[1]) == 0x8b;
+}
+
+GzipInputStream::GzipInputStream(std::unique_ptr<InputStream> compressed_input, const std::string& already_read_data)
+    : compressed_input_(std::move(compressed_input)),
+      already_read_data_(already_read_data),
+      blocks_(kNumOfQueuedBlocks),
+      current_block_position_(0),
+      failed_(false),
+      thread_(&GzipInputStream::Decompress, this) {}
+
+GzipInputStream::~GzipInputStream() {
+  blocks_.Close(); // stops the thread if it is still decompressing
+  thread_.join();
+}
+
+long long GzipInputStream::Read(char* data, const size_t size) {
+  if (current_block_position_ == current_block_.size()) {
+    if (!blocks_.Pop(current_block_))
+      return (failed_)? -1 : 0;
+    current_block_position_ = 0;
+  }
+  const size_t num_of_bytes = std::min(size, current_block_.size()-current_block_position_);
+  memcpy(data, current_block_.data()+current_block_position_, num_of_bytes);
+  current_block_position_ += num_of_bytes;
+  return num_of_bytes;
+}
+
+void GzipInputStream::Decompress() {
+// Runs on "thread_": reads and decompresses the input and queues the
+// decompressed data in blocks of "kBlockSize" bytes. Several gzip members
+// following each other (as written by "GzipOutputStream" or "cat a.gz b.gz")
+// are decompressed one after another.
+  z_stream stream = {};
+  if (inflateInit2(&stream, 15+16) != Z_OK) {
+    failed_ = true;
+    blocks_.Close();
+    return;
+  }
+  std::vector<char> input(1 << 18), block(kBlockSize);
+  stream.next_in = (Bytef*) already_read_data_.data();
+  stream.avail_in = already_read_data_.size();
+  stream.next_out = (Bytef*) block.data();
+  stream.avail_out = block.size();
+  bool is_end_of_input = false, is_between_members = false;
+  while (true) {
+    if (stream.avail_in == 0 && !is_end_of_input) {
+      const long long num_of_read_bytes = compressed_input_->Read(input.data(), input.size());
+      if (num_of_read_bytes < 0) {
+        failed_ = true;
+        break;
+      }
+      is_end_of_input = num_of_read_bytes == 0;
+      stream.next_in = (Bytef*) input.data();
+      stream.avail_in = num_of_read_bytes;
+    }
+    if (stream.avail_in == 0 && is_end_of_input) {
+      failed_ = !is_between_members; // the input ended in the middle of a gzip member
+      break;
+    }
+    const int status = inflate(&stream, Z_NO_FLUSH);
+    if (status == Z_STREAM_END) {
+      inflateReset(&stream);
+      is_between_members = true;
+    } else if (status == Z_OK)
+      is_between_members = false;
+    else if (status != Z_BUF_ERROR) {
+      failed_ = true;
+      break;
+    }
+    if (stream.avail_out == 0) {
+      if (!blocks_.Push(std::move(block)))
+        break; // nobody reads the data anymore
+      block.assign(kBlockSize, 0);
+      stream.next_out = (Bytef*) block.data();
+      stream.avail_out = block.size();
+    }
+  }
+  block.resize(block.size()-stream.avail_out);
+  if (!block.empty())
+    blocks_.Push(std::move(block));
+  inflateEnd(&stream);
+  blocks_.Close();
+}
+
+GzipOutputStream::GzipOutputStream(const int file_descriptor, const long long header_offset)
+    : file_descriptor_(file_descriptor),
+      header_offset_(header_offset),
+      header_member_size_(0),
+      blocks_(kNumOfQueuedBlocks),
+      failed_(false),
+      thread_(&GzipOutputStream::Compress, this) {
+  current_block_.reserve(kBlockSize);
+}
+
+GzipOutputStream::~GzipOutputStream() {
+  Close();
+}
+
+bool GzipOutputStream::WriteHeader(const char* data, const size_t size) {
+// Has to be called before "Write()" (the compressing thread doesn't write
+// anything before it gets the first block).
+  const std::string header_member = CompressHeader(data, size);
+  header_member_size_ = header_member.size();
+  if (!WriteAll(file_descriptor_, header_member.data(), header_member.size()))
+    failed_ = true;
+  return !failed_;
+}
+
+bool GzipOutputStream::Write(const char* data, size_t size) {
+// Copies "data" into blocks of "kBlockSize" bytes which are queued for
+// "thread_".
+  while (size > 0) {
+    const size_t num_of_bytes = std::min(size, kBlockSize-current_block_.size());
+    current_block_.insert(current_block_.end(), data, data+num_of_bytes);
+    data += num_of_bytes;
+    size -= num_of_bytes;
+    if (current_block_.size() == kBlockSize) {
+      blocks_.Push(std::move(current_block_));
+      current_block_ = std::vector<char>();
+      current_block_.reserve(kBlockSize);
+    }
+  }
+  return !failed_;
+}
+
+bool GzipOutputStream::RewriteHeader(const std::string& header) {
+// Overwrites the header member (at "header_offset_"). Since it is stored
+// uncompressed, a header line of the same length results in a member of the
+// same size.
+  const std::string header_member = CompressHeader(header.data(), header.length());
+  return header_offset_ >= 0 && header_member.size() == header_member_size_ && pwrite(file_descriptor_, header_member.data(), header_member.size(), header_offset_) == (ssize_t) header_member.size();
+}
+
+bool GzipOutputStream::Close() {
+  if (file_descriptor_ < 0)
+    return !failed_;
+  if (!current_block_.empty())
+    blocks_.Push(std::move(current_block_));
+  blocks_.Close();
+  thread_.join(); // the thread finishes the gzip member after the last block
+  if (close(file_descriptor_) != 0)
+    failed_ = true;
+  file_descriptor_ = -1;
+  return !failed_;
+}
+
+void GzipOutputStream::Compress() {
+// Runs on "thread_": compresses the queued blocks into one gzip member and
+// writes it.
+  z_stream stream = {};
+  if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15+16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+    failed_ = true;
+    std::vector<char> block;
+    while (blocks_.Pop(block)) {} // keeps "Write()" from blocking
+    return;
+  }
+  std::vector<char> block, output(1 << 18);
+  bool is_finished = false;
+  while (!is_finished) {
+    const bool has_block = blocks_.Pop(block);
+    stream.next_in = (Bytef*) block.data();
+    stream.avail_in = (has_block)? block.size() : 0;
+    do {
+      stream.next_out = (Bytef*) output.data();
+      stream.avail_out = output.size();
+      is_finished = deflate(&stream, (has_block)? Z_NO_FLUSH : Z_FINISH) == Z_STREAM_END;
+      if (!failed_ && !WriteAll(file_descriptor_, output.data(), output.size()-stream.avail_out))
+        failed_ = true;
+    } while (stream.avail_out == 0);
+  }
+  deflateEnd(&stream);
+}
+
+std::string GzipOutputStream::CompressHeader(const char* data, const size_t size) {
+// Returns a complete gzip member containing "data" uncompressed.
+  z_stream stream = {};
+  deflateInit2(&stream, Z_NO_COMPRESSION, Z_DEFLATED, 15+16, 8, Z_DEFAULT_STRATEGY);
+  std::string header_member(deflateBound(&stream, size), '\0');
+  stream.next_in = (Bytef*) data;
+  stream.avail_in = size;
+  stream.next_out = (Bytef*) &header_member[0];
+  stream.avail_out = header_member.size();
+  deflate(&stream, Z_FINISH);
+  header_member.resize(header_member.size()-stream.avail_out);
+  deflateEnd(&stream);
+  return header_member;
+}
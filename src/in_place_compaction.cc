@@ -0,0 +1,462 @@
+// in_place_compaction.cc
+
+// Copyright 2019 E. Decker
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Compaction of a word vector file in place (see "--in-place"): the kept
+// ranges of the file are shifted towards its beginning and the file is
+// truncated, so no second copy of the file is needed.
+//
+// Every step is recorded in a journal next to the file, so that an
+// interrupted compaction can be finished or rolled back. The journal holds
+// the plan (kept ranges, header lines and the removed bytes, which are usually
+// only a tiny part of the file) and a cursor: the number of blocks that are
+// written and synced. A block is only written if it can't overwrite the
+// source of a block after the cursor; otherwise the cursor is synced first.
+// If a block overlaps its own source (because less than a block was removed
+// in front of it), its data is written to the journal before it is written to
+// the file. So writing the blocks from the cursor on again always gives the
+// same result.
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "function_word_vector_killer.h"
+
+namespace {
+
+const char kJournalMagic[8] = {'F', 'W', 'V', 'K', 'J', 'R', 'N', 'L'};
+const uint32_t kJournalVersion = 1;
+
+struct JournalHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t block_size;
+  uint64_t original_size; // size of the file before the compaction
+  uint64_t final_size; // size of the file after the compaction
+  uint64_t num_of_kept_ranges;
+  uint64_t removed_data_size;
+  uint32_t header_size; // length of the header line (before and after the compaction)
+  uint32_t append_newline; // 1 if the last line of the compacted file needs a newline
+  uint32_t reserved;
+  uint32_t checksum; // of the plan (everything but the states)
+};
+static_assert(sizeof(JournalHeader) == 64, "the header of a journal must not contain padding");
+
+// Phases of the compaction a "JournalState" refers to.
+const uint32_t kCompacting = 0, kRollingBack = 1;
+
+struct JournalState {
+// Two states are stored in turns, so that one is always intact even if
+// writing the other one is interrupted.
+  uint64_t sequence; // the valid state with the higher sequence is the current one
+  uint32_t phase;
+  uint32_t pending_block_size; // not 0 if the data of "next_block" is stored in the journal
+  uint64_t next_block; // every block before it is written and synced
+  uint32_t pending_block_checksum;
+  uint32_t checksum; // of the fields above
+};
+static_assert(sizeof(JournalState) == 32, "the state of a journal must not contain padding");
+
+const off_t kStatesOffset = sizeof(JournalHeader), kPlanOffset = kStatesOffset+2*sizeof(JournalState);
+
+struct Block {
+// Bytes to copy within the file (or from the removed data in the journal if
+// "journal_offset" isn't -1).
+  uint64_t source;
+  uint64_t destination;
+  uint64_t size;
+  int64_t journal_offset;
+};
+
+uint32_t Checksum(const char* data, size_t size, uint32_t checksum = 0) {
+  while (size > 0) {
+    const uInt part = std::min(size, (size_t) 1 << 30);
+    checksum = crc32(checksum, reinterpret_cast<const Bytef*>(data), part);
+    data += part;
+    size -= part;
+  }
+  return checksum;
+}
+
+bool ReadAll(const int file_descriptor, char* data, size_t size, off_t offset) {
+  while (size > 0) {
+    const ssize_t num_of_read_bytes = pread(file_descriptor, data, size, offset);
+    if (num_of_read_bytes <= 0) {
+      if (num_of_read_bytes < 0 && errno == EINTR)
+        continue;
+      return false;
+    }
+    data += num_of_read_bytes;
+    size -= num_of_read_bytes;
+    offset += num_of_read_bytes;
+  }
+  return true;
+}
+
+bool WriteAllAt(const int file_descriptor, const char* data, size_t size, off_t offset) {
+  while (size > 0) {
+    const ssize_t num_of_written_bytes = pwrite(file_descriptor, data, size, offset);
+    if (num_of_written_bytes < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    data += num_of_written_bytes;
+    size -= num_of_written_bytes;
+    offset += num_of_written_bytes;
+  }
+  return true;
+}
+
+bool Overlap(const uint64_t begin, const uint64_t end, const uint64_t other_begin, const uint64_t other_end) {
+  return begin < other_end && other_begin < end;
+}
+
+class Journal {
+// The journal of the compaction of "file" (see above).
+ public:
+  Journal(const std::string& file) : state(), path_(GetJournalFile(file)), file_descriptor_(-1) {}
+  ~Journal() {
+    if (file_descriptor_ >= 0)
+      close(file_descriptor_);
+  }
+  bool Create(const char* data, const size_t size, const std::vector<ByteRange>& kept_ranges, const std::string& final_header, const bool append_newline, const size_t block_size);
+  bool Load();
+  bool SaveState(const uint32_t phase, const uint64_t next_block, const char* pending_block = NULL, const uint32_t pending_block_size = 0);
+  bool ReadPendingBlock(char* data) const;
+  bool Remove();
+  std::vector<Block> GetCompactionBlocks() const;
+  std::vector<Block> GetRollBackBlocks() const;
+  const std::string& path() const { return path_; }
+
+  JournalHeader header;
+  JournalState state;
+  std::vector<ByteRange> kept_ranges;
+  std::string original_header, final_header, removed_data;
+
+ private:
+  const std::string path_;
+  int file_descriptor_;
+  uint32_t PlanChecksum() const;
+  off_t pending_block_offset() const { return kPlanOffset+header.num_of_kept_ranges*sizeof(ByteRange)+2*header.header_size+header.removed_data_size; }
+};
+
+uint32_t Journal::PlanChecksum() const {
+  JournalHeader header_without_checksum = header;
+  header_without_checksum.checksum = 0;
+  uint32_t checksum = Checksum(reinterpret_cast<const char*>(&header_without_checksum), sizeof(header_without_checksum));
+  checksum = Checksum(reinterpret_cast<const char*>(kept_ranges.data()), kept_ranges.size()*sizeof(ByteRange), checksum);
+  checksum = Checksum(original_header.data(), original_header.size(), checksum);
+  checksum = Checksum(final_header.data(), final_header.size(), checksum);
+  return Checksum(removed_data.data(), removed_data.size(), checksum);
+}
+
+bool Journal::Create(const char* data, const size_t size, const std::vector<ByteRange>& ranges, const std::string& new_header, const bool append_newline, const size_t block_size) {
+// Writes the plan of the compaction of "data" (the content of the file) to a
+// temporary file, syncs it and renames it to the journal, so that the journal
+// is either complete or doesn't exist.
+  kept_ranges = ranges;
+  final_header = new_header;
+  original_header.assign(data, std::min(final_header.size(), size));
+  uint64_t position = 0, final_size = 0;
+  for (const auto& range : kept_ranges) {
+    removed_data.append(data+position, range.begin-position);
+    final_size += range.end-range.begin;
+    position = range.end;
+  }
+  removed_data.append(data+position, size-position);
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kJournalMagic, sizeof(kJournalMagic));
+  header.version = kJournalVersion;
+  header.block_size = block_size;
+  header.original_size = size;
+  header.final_size = final_size+((append_newline)? 1 : 0);
+  header.num_of_kept_ranges = kept_ranges.size();
+  header.removed_data_size = removed_data.size();
+  header.header_size = final_header.size();
+  header.append_newline = append_newline;
+  header.checksum = PlanChecksum();
+  const std::string temporary_path = path_+".tmp";
+  file_descriptor_ = open(temporary_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (file_descriptor_ < 0)
+    return false;
+  std::string plan(reinterpret_cast<const char*>(&header), sizeof(header));
+  plan.append(2*sizeof(JournalState), '\0');
+  plan.append(reinterpret_cast<const char*>(kept_ranges.data()), kept_ranges.size()*sizeof(ByteRange));
+  plan += original_header+final_header+removed_data;
+  if (!WriteAllAt(file_descriptor_, plan.data(), plan.size(), 0) || !SaveState(kCompacting, 0) || rename(temporary_path.c_str(), path_.c_str()) != 0)
+    return false;
+  SyncDirectoryOf(path_); // so that the renamed journal survives a crash
+  return true;
+}
+
+bool Journal::Load() {
+// Reads the journal and returns "false" if it doesn't exist or is damaged.
+  file_descriptor_ = open(path_.c_str(), O_RDWR);
+  if (file_descriptor_ < 0 || !ReadAll(file_descriptor_, reinterpret_cast<char*>(&header), sizeof(header), 0))
+    return false;
+  struct stat journal_status;
+  if (memcmp(header.magic, kJournalMagic, sizeof(kJournalMagic)) != 0 || header.version != kJournalVersion || header.block_size == 0 || fstat(file_descriptor_, &journal_status) != 0 || header.num_of_kept_ranges > (uint64_t) journal_status.st_size/sizeof(ByteRange) || header.removed_data_size > (uint64_t) journal_status.st_size || header.header_size > (uint64_t) journal_status.st_size)
+    return false;
+  kept_ranges.resize(header.num_of_kept_ranges);
+  original_header.resize(header.header_size);
+  final_header.resize(header.header_size);
+  removed_data.resize(header.removed_data_size);
+  off_t offset = kPlanOffset;
+  if (!ReadAll(file_descriptor_, reinterpret_cast<char*>(kept_ranges.data()), kept_ranges.size()*sizeof(ByteRange), offset))
+    return false;
+  offset += kept_ranges.size()*sizeof(ByteRange);
+  if (!ReadAll(file_descriptor_, &original_header[0], original_header.size(), offset) || !ReadAll(file_descriptor_, &final_header[0], final_header.size(), offset+original_header.size()) || !ReadAll(file_descriptor_, &removed_data[0], removed_data.size(), offset+2*original_header.size()) || PlanChecksum() != header.checksum)
+    return false;
+  bool has_state = false;
+  for (int i = 0; i < 2; ++i) {
+    JournalState slot;
+    if (ReadAll(file_descriptor_, reinterpret_cast<char*>(&slot), sizeof(slot), kStatesOffset+i*sizeof(slot)) && slot.checksum == Checksum(reinterpret_cast<const char*>(&slot), offsetof(JournalState, checksum)) && (!has_state || slot.sequence > state.sequence)) {
+      state = slot;
+      has_state = true;
+    }
+  }
+  return has_state;
+}
+
+bool Journal::SaveState(const uint32_t phase, const uint64_t next_block, const char* pending_block, const uint32_t pending_block_size) {
+// Syncs a new state (and the data of the block "next_block" if it is given)
+// to the journal. The state is written over the older of the two states.
+  JournalState new_state = {};
+  new_state.sequence = state.sequence+1;
+  new_state.phase = phase;
+  new_state.next_block = next_block;
+  new_state.pending_block_size = pending_block_size;
+  if (pending_block_size > 0) {
+    new_state.pending_block_checksum = Checksum(pending_block, pending_block_size);
+    if (!WriteAllAt(file_descriptor_, pending_block, pending_block_size, pending_block_offset()))
+      return false;
+  }
+  new_state.checksum = Checksum(reinterpret_cast<const char*>(&new_state), offsetof(JournalState, checksum));
+  if (!WriteAllAt(file_descriptor_, reinterpret_cast<const char*>(&new_state), sizeof(new_state), kStatesOffset+(new_state.sequence%2)*sizeof(new_state)) || fdatasync(file_descriptor_) != 0)
+    return false;
+  state = new_state;
+  return true;
+}
+
+bool Journal::ReadPendingBlock(char* data) const {
+  return ReadAll(file_descriptor_, data, state.pending_block_size, pending_block_offset()) && Checksum(data, state.pending_block_size) == state.pending_block_checksum;
+}
+
+bool Journal::Remove() {
+  close(file_descriptor_);
+  file_descriptor_ = -1;
+  return unlink(path_.c_str()) == 0;
+}
+
+std::vector<Block> Journal::GetCompactionBlocks() const {
+// Returns the blocks that move the kept ranges (in order) directly behind
+// each other.
+  std::vector<Block> blocks;
+  uint64_t destination = 0;
+  for (const auto& range : kept_ranges) {
+    const uint64_t size = range.end-range.begin;
+    for (uint64_t offset = 0; range.begin != destination && offset < size; offset += header.block_size)
+      blocks.push_back({range.begin+offset, destination+offset, std::min(size-offset, (uint64_t) header.block_size), -1});
+    destination += size;
+  }
+  return blocks;
+}
+
+std::vector<Block> Journal::GetRollBackBlocks() const {
+// Returns the blocks that move the kept ranges of a compacted file back to
+// their original positions (starting with the last one and the end of every
+// range, so that no range overwrites one that hasn't been moved yet) and
+// restore the removed data in between.
+  std::vector<uint64_t> compacted_positions(kept_ranges.size()+1, 0), removed_data_offsets(kept_ranges.size()+1, 0);
+  for (size_t i = 0; i < kept_ranges.size(); ++i) {
+    compacted_positions[i+1] = compacted_positions[i]+kept_ranges[i].end-kept_ranges[i].begin;
+    removed_data_offsets[i+1] = removed_data_offsets[i]+kept_ranges[i].begin-((i > 0)? kept_ranges[i-1].end : 0);
+  }
+  std::vector<Block> blocks;
+  const uint64_t last_end = (kept_ranges.empty())? 0 : kept_ranges.back().end;
+  if (header.original_size > last_end)
+    blocks.push_back({0, last_end, header.original_size-last_end, (int64_t) removed_data_offsets.back()});
+  for (size_t i = kept_ranges.size(); i-- > 0;) {
+    const uint64_t size = kept_ranges[i].end-kept_ranges[i].begin;
+    for (uint64_t remaining = size; kept_ranges[i].begin != compacted_positions[i] && remaining > 0;) {
+      const uint64_t block_size = std::min(remaining, (uint64_t) header.block_size);
+      remaining -= block_size;
+      blocks.push_back({compacted_positions[i]+remaining, kept_ranges[i].begin+remaining, block_size, -1});
+    }
+    const uint64_t gap_begin = (i > 0)? kept_ranges[i-1].end : 0;
+    if (kept_ranges[i].begin > gap_begin)
+      blocks.push_back({0, gap_begin, kept_ranges[i].begin-gap_begin, (int64_t) removed_data_offsets[i]});
+  }
+  return blocks;
+}
+
+bool WriteBlocks(const int file_descriptor, Journal& journal, const std::vector<Block>& blocks, const uint32_t phase, long long& num_of_moved_bytes) {
+// Writes the blocks from the cursor of the "journal" on (see above) and
+// returns "false" if reading, writing or syncing failed.
+  std::vector<char> buffer(journal.header.block_size);
+  // Ranges of the sources and destinations of the blocks written since the
+  // cursor was synced the last time (empty if begin == end).
+  uint64_t sources_begin = 0, sources_end = 0, destinations_begin = 0, destinations_end = 0;
+  auto sync_cursor = [&](const uint64_t next_block) {
+    sources_begin = sources_end = destinations_begin = destinations_end = 0;
+    return fdatasync(file_descriptor) == 0 && journal.SaveState(phase, next_block);
+  };
+  for (uint64_t i = journal.state.next_block; i < blocks.size(); ++i) {
+    const Block& block = blocks[i];
+    const uint64_t destination_end = block.destination+block.size;
+    const bool is_from_journal = block.journal_offset >= 0;
+    if (Overlap(block.destination, destination_end, sources_begin, sources_end) || (!is_from_journal && Overlap(block.source, block.source+block.size, destinations_begin, destinations_end))) {
+      if (!sync_cursor(i))
+        return false;
+    }
+    const char* data = buffer.data();
+    if (is_from_journal)
+      data = journal.removed_data.data()+block.journal_offset;
+    else if (journal.state.pending_block_size > 0 && journal.state.next_block == i) {
+      if (!journal.ReadPendingBlock(buffer.data()))
+        return false;
+    } else if (!ReadAll(file_descriptor, buffer.data(), block.size, block.source))
+      return false;
+    if (!is_from_journal && Overlap(block.destination, destination_end, block.source, block.source+block.size)) {
+      // The block overwrites its own source, so its data is kept in the
+      // journal until it is written.
+      if ((sources_end > sources_begin && !sync_cursor(i)) || (journal.state.pending_block_size == 0 && !journal.SaveState(phase, i, data, block.size)))
+        return false;
+      if (!WriteAllAt(file_descriptor, data, block.size, block.destination) || !sync_cursor(i+1))
+        return false;
+    } else {
+      if (!WriteAllAt(file_descriptor, data, block.size, block.destination))
+        return false;
+      if (!is_from_journal) {
+        sources_begin = (sources_end > sources_begin)? std::min(sources_begin, block.source) : block.source;
+        sources_end = std::max(sources_end, block.source+block.size);
+      }
+      destinations_begin = (destinations_end > destinations_begin)? std::min(destinations_begin, block.destination) : block.destination;
+      destinations_end = std::max(destinations_end, destination_end);
+    }
+    num_of_moved_bytes += block.size;
+  }
+  return sync_cursor(blocks.size());
+}
+
+bool RunCompaction(const std::string& file, Journal& journal, const bool roll_back, long long& num_of_moved_bytes) {
+// Finishes the compaction recorded in "journal" (first of all if it shall be
+// rolled back) and rolls it back if "roll_back" is "true". Removes the
+// journal once the file is complete.
+  const int file_descriptor = open(file.c_str(), O_RDWR);
+  struct stat file_status;
+  if (file_descriptor < 0 || fstat(file_descriptor, &file_status) != 0) {
+    std::cerr << "ERROR: OPENING \"" << file << "\" FAILED!\n";
+    if (file_descriptor >= 0)
+      close(file_descriptor);
+    return false;
+  }
+  bool succeeded = true;
+  if (journal.state.phase == kCompacting) {
+    succeeded = WriteBlocks(file_descriptor, journal, journal.GetCompactionBlocks(), kCompacting, num_of_moved_bytes);
+    if (succeeded && !roll_back) {
+      // All kept ranges are in place: corrects the header line, terminates
+      // the last line and cuts off the rest (all of which can simply be done
+      // again if it is interrupted).
+      succeeded = WriteAllAt(file_descriptor, journal.final_header.data(), journal.final_header.size(), 0) && (journal.header.append_newline == 0 || WriteAllAt(file_descriptor, "\n", 1, journal.header.final_size-1)) && ftruncate(file_descriptor, journal.header.final_size) == 0 && fsync(file_descriptor) == 0;
+    }
+    if (succeeded && roll_back)
+      succeeded = journal.SaveState(kRollingBack, 0);
+  }
+  if (succeeded && journal.state.phase == kRollingBack) {
+    // The file might be truncated already; it is extended to its original
+    // size before the blocks are moved back.
+    succeeded = ftruncate(file_descriptor, journal.header.original_size) == 0 && WriteBlocks(file_descriptor, journal, journal.GetRollBackBlocks(), kRollingBack, num_of_moved_bytes) && WriteAllAt(file_descriptor, journal.original_header.data(), journal.original_header.size(), 0) && fsync(file_descriptor) == 0;
+  }
+  close(file_descriptor);
+  if (!succeeded) {
+    std::cerr << "ERROR: WRITING \"" << file << "\" FAILED! Run the program with \"--in-place\" again to finish (or with \"--rollback-in-place\" to undo) the compaction.\n";
+    return false;
+  }
+  if (!journal.Remove())
+    std::cerr << "WARNING: \"" << journal.path() << "\" couldn't be removed; delete it before running the program with \"--in-place\" on \"" << file << "\" again.\n";
+  return true;
+}
+
+}  // namespace
+
+std::string GetJournalFile(const std::string& file) {
+  return file+".fwvk-journal";
+}
+
+bool InPlaceCompactionIsInterrupted(const std::string& file) {
+  struct stat journal_status;
+  return stat(GetJournalFile(file).c_str(), &journal_status) == 0;
+}
+
+bool CompactFileInPlace(const std::string& file, const char* data, const size_t size, const std::vector<ByteRange>& kept_ranges, const std::string& final_header, const bool append_newline, const size_t block_size, long long& num_of_moved_bytes) {
+// Removes everything but the "kept_ranges" (sorted byte ranges that don't
+// overlap) from "file", whose content is "data" (i.e. the file must be mapped
+// and must not have been changed since it was mapped), replaces its header
+// line by "final_header" (which must be as long as the original one) and
+// appends a newline if "append_newline" is "true". The mapped data isn't read
+// any more once the file is changed.
+  num_of_moved_bytes = 0;
+  if (kept_ranges.size() == 1 && kept_ranges[0].begin == 0 && kept_ranges[0].end == size && !append_newline && final_header.compare(0, std::string::npos, data, std::min(final_header.size(), size)) == 0)
+    return true; // nothing to remove and nothing to change
+  Journal journal(file);
+  if (!journal.Create(data, size, kept_ranges, final_header, append_newline, std::max(block_size, (size_t) 1 << 12))) {
+    std::cerr << "ERROR: CREATING \"" << journal.path() << "\" FAILED! The file wasn't changed.\n";
+    unlink((journal.path()+".tmp").c_str());
+    return false;
+  }
+  return RunCompaction(file, journal, false, num_of_moved_bytes);
+}
+
+bool FinishInPlaceCompaction(const std::string& file, const bool roll_back, long long& num_of_moved_bytes) {
+// Finishes (or rolls back) an interrupted compaction of "file".
+  num_of_moved_bytes = 0;
+  Journal journal(file);
+  if (!journal.Load()) {
+    std::cerr << "ERROR: READING \"" << journal.path() << "\" FAILED! The journal is missing or damaged.\n";
+    return false;
+  }
+  struct stat file_status;
+  if (stat(file.c_str(), &file_status) != 0 || ((uint64_t) file_status.st_size != journal.header.original_size && (uint64_t) file_status.st_size != journal.header.final_size)) {
+    std::cerr << "ERROR: \"" << file << "\" DOESN'T MATCH ITS JOURNAL \"" << journal.path() << "\"!\n";
+    return false;
+  }
+  return RunCompaction(file, journal, roll_back, num_of_moved_bytes);
+}
+
+bool KeptRangeCollector::Write(const char* data, const size_t size) {
+// Only the kept ranges of the input and the newline terminating its last line
+// are written (see "Killer::FinishOutputFile()").
+  if (data >= begin_ && data+size <= end_) {
+    const uint64_t range_begin = data-begin_;
+    if (!kept_ranges_.empty() && kept_ranges_.back().end == range_begin)
+      kept_ranges_.back().end += size;
+    else
+      kept_ranges_.push_back({range_begin, range_begin+size});
+    return true;
+  }
+  if (size == 1 && *data == '\n') {
+    appends_newline_ = true;
+    return true;
+  }
+  return false;
+}
@@ -15,146 +15,388 @@
 // limitations under the License.
 
 #include <algorithm>
-#include <fstream>
+#include <cstring>
 #include <iostream>
-#include <random>
-#include <sstream>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "function_word_vector_killer.h"
 
-Killer::Killer(const std::string& input_file, const std::string& output_file, const std::vector<bool>& words_to_remove, const int language)
+namespace {
+
+int64_t GetModificationTime(const std::string& file) {
+// Returns the time of the last modification of "file" in nanoseconds (or -1
+// if it can't be found).
+  struct stat file_status;
+  if (stat(file.c_str(), &file_status) != 0)
+    return -1;
+  return (int64_t) file_status.st_mtim.tv_sec*1000000000+file_status.st_mtim.tv_nsec;
+}
+
+}  // namespace
+
+Killer::Killer(const std::string& input_file, const std::string& output_file, const std::vector<bool>& words_to_remove, const int language, const KillerOptions& options)
     : input_file_(input_file),
       output_file_(output_file),
       words_to_remove_(words_to_remove),
-      language_(language) {
-  SelectAndRemoveWords();
+      options_(options),
+      selected_categories_(GetCategoryMask(words_to_remove)),
+      failed_(false) {
+  SelectAndRemoveWords(language);
+}
+
+Killer::Killer(const std::string& input_file, const std::string& output_file, const std::vector<bool>& words_to_remove, const FunctionWordSet& function_words_to_remove, const KillerOptions& options)
+    : input_file_(input_file),
+      output_file_(output_file),
+      words_to_remove_(words_to_remove),
+      options_(options),
+      selected_categories_(GetCategoryMask(words_to_remove)),
+      failed_(false) {
+  // Used for several input files at once (see "RunBatch()"): the function
+  // words are loaded by the caller and nothing but errors is printed.
+  RemoveWords(function_words_to_remove);
 }
 
 Killer::~Killer() {}
 
-void Killer::SelectAndRemoveWords() {
-  BinaryTree function_words_to_remove;
-  auto rng = std::default_random_engine {};
-  std::vector<std::string> list_of_words_to_remove;
-  const std::vector<std::string> labels_of_words_to_remove = {"Adpositions:\n\t", "Articles etc. (various pronouns, demonstratives, ...):\n\t", "Conjunctions and subjunctions:\n\t", "Interjections:\n\t", "Interrogative words:\n\t", "Numerals:\n\t", "Particles:\n\t", "Personal pronouns and possessives:\n\t", "Temporal words:\n\t", "Miscellaneous words:\n\t"};
+void Killer::SelectAndRemoveWords(const int language) {
+  const std::unique_ptr<FunctionWordSet> function_words = LoadFunctionWordSet(words_to_remove_, language, options_);
+  if (!function_words) {
+    failed_ = true;
+    return;
+  }
+  const FunctionWordSet& function_words_to_remove = *function_words; // built once and only read from now on
   std::cout << "\nThe following words will be removed from your word vector file (\"" << input_file_ << "\"):\n";
-  for (unsigned i = 0; i < words_to_remove_.size(); ++i) {
-    if (words_to_remove_[i]) {
-      std::cout << labels_of_words_to_remove[i];
-      list_of_words_to_remove = LoadFunctionWords(i);
-      if (!list_of_words_to_remove.empty()) {
-        // Prints the "words_to_remove_" in the same order as they can be found
-        // in their txt-file.
-        for (auto it = list_of_words_to_remove.begin(); it != list_of_words_to_remove.end(); ++it)
-          std::cout << *it << ((it != std::prev(list_of_words_to_remove.end()))? ", " : "\n");
-      }
-      // Shuffles the vector "list_of_words_to_remove" in order to improve the
-      // binary tree that is about to be built (the lists of function words in
-      // the directory "data" are sorted in alphabetical order (except for the
-      // numerals) to make it easier for the user to find a certain word in
-      // those files).
-      std::shuffle(list_of_words_to_remove.begin(), list_of_words_to_remove.end(), rng);
-      for (auto& word_to_remove : list_of_words_to_remove)
-        function_words_to_remove.AddWord(word_to_remove); // adds the selected functions words to the binary tree
+  PrintFunctionWords(function_words_to_remove, selected_categories_);
+  const uint8_t token_rules = GetTokenRules(selected_categories_, options_);
+  if (token_rules != 0) {
+    std::cout << "Words matching the token rules:\n\t";
+    for (int i = 0; i < kNumOfTokenRules; ++i) {
+      if (token_rules & (1 << i))
+        std::cout << kTokenRuleNames[i] << ((token_rules >> (i+1))? ", " : "");
     }
-  }
-  std::cout << "\n\tCreating new file (\"" << output_file_ << "\") without those words and their vectors..." << std::endl;
-  int num_of_removed_vectors = 0, num_of_checked_vectors = 0, flush_interval_factor = 1;
-  std::string line, word;
-  std::ifstream input_file_stream(input_file_);
-  std::ofstream output_file_stream(output_file_);
-  // Reads "input_file_", checks for every line if the word vector should be
-  // removed and writes those that shouldn't be removed in "output_file_".
-  while (std::getline(input_file_stream, line)) {
-    word = SetToLowerCase(line.substr(0, line.find_first_of(' '))); // note that the word comparison is not case sensitive!
-    if (words_to_remove_[5] && IsNumber(word)) // if numerals are selected to be removed every "word vector" representing a numeric string will be removed
-      num_of_removed_vectors++;
-    // "RemoveWord()" returns "true" if "word" was both found and removed from
-    // the binary tree, and "false" if not (removing the word makes the binary
-    // tree smaller and therefore upcoming searches in many cases faster).
-    else if (!function_words_to_remove.RemoveWord(word))
-      output_file_stream << line << '\n';
-    else
-      num_of_removed_vectors++;
-    // Flushes the "output_file_stream" in an interval of 1000 (with respect to
-    // the number of word vectors that have already been checked).
-    num_of_checked_vectors++;
-    if (num_of_checked_vectors == (1000*flush_interval_factor)) {
-      output_file_stream.flush();
-      flush_interval_factor++;
+    if (token_rules & (1 << kLengthRule)) {
+      std::cout << " (";
+      if (options_.min_word_length > 0)
+        std::cout << "less than " << options_.min_word_length << ((options_.max_word_length > 0)? " or " : "");
+      if (options_.max_word_length > 0)
+        std::cout << "more than " << options_.max_word_length;
+      std::cout << " characters)";
     }
+    std::cout << '\n';
   }
+  if (options_.match_compounds)
+    std::cout << "Compound words of those words (joined by '_' or '-', e.g. \"as_well_as\")\n";
+  if (options_.duplicate_handling != kKeepAllOccurrences)
+    std::cout << "Duplicate words (all word vectors of a word but the " << ((options_.duplicate_handling == kKeepFirstOccurrence)? "first" : "last") << " one)\n";
+  if (options_.in_place)
+    std::cout << "\n\tRemoving those words and their vectors from \"" << input_file_ << "\" in place..." << std::endl;
+  else if (options_.write_matrix)
+    std::cout << "\n\tConverting the other word vectors into a " << ((options_.use_float16)? "float16" : "float32") << " matrix (\"" << output_file_ << "\") and a vocab file (\"" << output_file_ << ".vocab\")..." << std::endl;
+  else if (options_.num_of_shards > 1)
+    std::cout << "\n\tSplitting the other word vectors " << ((options_.shard_by_hash)? "by their word" : "in turns") << " into " << options_.num_of_shards << " shards (\"" << GetShardFile(output_file_, 0, options_.num_of_shards) << "\" etc., listed in \"" << output_file_ << ".manifest.json\")..." << std::endl;
+  else
+    std::cout << "\n\tCreating new file (\"" << output_file_ << "\") without those words and their vectors..." << std::endl;
+  RemoveWords(function_words_to_remove);
   std::cout << "\t---Done.\n";
-  std::cout << "\nNumber of removed word vectors = " << num_of_removed_vectors << '\n';
+  std::cout << "\nNumber of removed word vectors = " << statistics_.num_of_removed_vectors << '\n';
+  // Shows which categories the removed word vectors belong to.
+  for (int i = 0; i < kNumOfTokenRules; ++i) {
+    if (statistics_.num_of_removed_vectors_per_rule[i] > 0)
+      std::cout << '\t' << kTokenRuleNames[i] << ": " << statistics_.num_of_removed_vectors_per_rule[i] << '\n';
+  }
+  if (statistics_.num_of_removed_compounds > 0)
+    std::cout << "\tcompound words: " << statistics_.num_of_removed_compounds << '\n';
+  if (statistics_.num_of_removed_duplicates > 0)
+    std::cout << "\tduplicates: " << statistics_.num_of_removed_duplicates << '\n';
+  for (int i = 0; i < kNumOfCategories; ++i) {
+    if (statistics_.num_of_removed_vectors_per_category[i] > 0)
+      std::cout << '\t' << kCategoryNames[i] << ": " << statistics_.num_of_removed_vectors_per_category[i] << '\n';
+  }
+  if (!options_.statistics_file.empty() && WriteRunStatistics(statistics_, input_file_, output_file_, options_.statistics_file))
+    std::cout << "Run statistics written to \"" << options_.statistics_file << "\".\n";
+}
+
+void Killer::RemoveWords(const FunctionWordSet& function_words_to_remove) {
+// Writes every word vector of "input_file_" that isn't removed to
+// "output_file_" and collects the "statistics_" of the run. The input file is
+// scanned in place if it can be mapped into memory; otherwise (e.g. if it is
+// a pipe) it is read block by block as a stream. Compressed input files have
+// to be decompressed first and are therefore read as streams as well.
+  const auto start = std::chrono::steady_clock::now();
+  statistics_.num_of_threads = std::max(options_.num_of_threads, 1u);
+  statistics_.buffer_size = options_.buffer_size;
+  word_filter_.reset(new WordFilter(function_words_to_remove, selected_categories_, options_));
+  const MappedFile mapped_input_file(input_file_);
+  const bool is_mapped = mapped_input_file.IsMapped() && !IsGzipCompressed(mapped_input_file.data(), mapped_input_file.size());
+  if (options_.in_place)
+    CompactInputFile(mapped_input_file, is_mapped, function_words_to_remove);
+  else if ((options_.checkpoint_interval > 0 || options_.resume) && (!is_mapped || options_.compress_output || options_.write_matrix || options_.duplicate_handling != kKeepAllOccurrences || options_.num_of_shards > 1 || output_file_ == "-")) {
+    std::cerr << "ERROR: THE RUN ON \"" << input_file_ << "\" CAN'T BE CHECKPOINTED! Checkpoints need an uncompressed regular input file, an uncompressed regular output file and no \"--matrix\", \"--dedup\" or \"--shards\".\n";
+    failed_ = true;
+  } else if (is_mapped) {
+    // An interrupted run is continued from its checkpoint (if there is one).
+    RunCheckpoint checkpoint;
+    const bool resumes = options_.resume && LoadValidCheckpoint(mapped_input_file, function_words_to_remove, checkpoint);
+    const std::unique_ptr<OutputStream> output = (failed_)? NULL : OpenOutputFile((resumes)? checkpoint.output_offset : -1);
+    if (output)
+      FilterMappedFile(mapped_input_file, function_words_to_remove, *output, (resumes)? &checkpoint : NULL);
+    else
+      failed_ = true;
+    if (options_.checkpoint_interval > 0 && !failed_)
+      unlink(GetCheckpointFile(output_file_).c_str()); // the run is complete
+  } else
+    FilterFileStream();
+  statistics_.input_format = (header_.is_binary)? "binary" : "text";
+  statistics_.total_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
 }
 
-std::vector<std::string> Killer::LoadFunctionWords(const int index) {
-// Loads the function words via index (the function words should be saved in
-// txt-files (check the paths!)).
-  const std::string directory_to_open = (language_ == 0)? "data/english" : "data/german";
-  std::string file_to_open, line;
-  switch (index) {
-   case 0:
-    file_to_open = "adpositions.txt";
-    break;
-   case 1:
-    file_to_open = "articles_and_the_like.txt";
-    break;
-   case 2:
-    file_to_open = "conjunctions_and_subjunctions.txt";
-    break;
-   case 3:
-    file_to_open = "interjections.txt";
-    break;
-   case 4:
-    file_to_open = "interrogative_words.txt";
-    break;
-   case 5:
-    file_to_open = "numerals.txt";
-    break;
-   case 6:
-    file_to_open = "particles.txt";
-    break;
-   case 7:
-    file_to_open = "personal_pronouns_and_possessives.txt";
-    break;
-   case 8:
-    file_to_open = "temporal_words.txt";
-    break;
-   case 9:
-    file_to_open = "miscellaneous_words.txt";
-  }
-  if (!FileIsValid(directory_to_open+"/"+file_to_open)) {
-    std::cerr << "\tThose function words couldn't be added to the words to remove.\n";
-    return {}; // returns an empty vector if the file is bad or couldn't be found
-  } else {
-    std::ifstream file_stream(directory_to_open+"/"+file_to_open);
-    std::getline(file_stream, line);
-    return GetWordsFromALine(line);
+void Killer::CompactInputFile(const MappedFile& input, const bool is_mapped, const FunctionWordSet& function_words_to_remove) {
+// Removes the word vectors from "input_file_" itself (see "--in-place"): the
+// mapped "input" is filtered as usual, but the kept ranges are only collected
+// and then moved together within the file (see "CompactFileInPlace()").
+  if (!is_mapped || input_file_ == "-") {
+    std::cerr << "ERROR: \"" << input_file_ << "\" CAN'T BE CHANGED IN PLACE! Only uncompressed regular files can.\n";
+    failed_ = true;
+    return;
   }
+  KeptRangeCollector kept_ranges(input.data(), input.data()+input.size());
+  FilterMappedFile(input, function_words_to_remove, kept_ranges);
+  if (failed_)
+    return;
+  const auto start = std::chrono::steady_clock::now();
+  // The header line stays as it is if it couldn't be rewritten.
+  const std::string header = (kept_ranges.header().empty())? std::string(input.data(), header_.length) : kept_ranges.header();
+  long long num_of_moved_bytes;
+  if (!CompactFileInPlace(input_file_, input.data(), input.size(), kept_ranges.kept_ranges(), header, kept_ranges.appends_newline(), options_.buffer_size, num_of_moved_bytes))
+    failed_ = true;
+  statistics_.num_of_written_bytes = num_of_moved_bytes;
+  statistics_.write_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
 }
 
-std::vector<std::string> Killer::GetWordsFromALine(const std::string& line) {
-// Returns a std::vector containing all words found in a line (every line will
-// be equal to the content of a function word file).
-  std::stringstream stream(line);
-  std::string word;
-  std::vector<std::string> words;
-  while (std::getline(stream, word, ' '))
-    words.push_back(word);
-  return words;
+void Killer::FilterMappedFile(const MappedFile& input, const FunctionWordSet& function_words_to_remove, OutputStream& output, const RunCheckpoint* resumed_checkpoint) {
+// Filters the mapped "input" at once on "options_.num_of_threads" threads
+// (see "VectorFilter::FilterMapped()") and writes the kept word vectors to
+// "output". Checkpoints are saved between two chunks (if
+// "options_.checkpoint_interval" is set); a run that is resumed from a
+// "resumed_checkpoint" starts where that was saved.
+  VectorFilter filter(*word_filter_, output, options_);
+  auto last_checkpoint = std::chrono::steady_clock::now();
+  ProgressReporter progress(options_.progress_interval, input.size());
+  const bool filtered = filter.FilterMapped(input.data(), input.size(), resumed_checkpoint, [&]() {
+    const RunStatistics& statistics = filter.statistics();
+    progress.Update(statistics.num_of_read_bytes, statistics.num_of_read_bytes, statistics.num_of_checked_vectors);
+    if (options_.checkpoint_interval > 0 && (uint64_t) statistics.num_of_read_bytes < input.size() && std::chrono::duration<double>(std::chrono::steady_clock::now()-last_checkpoint).count() >= options_.checkpoint_interval) {
+      if (!SaveRunCheckpoint(input, function_words_to_remove, filter))
+        std::cerr << "WARNING: The checkpoint \"" << GetCheckpointFile(output_file_) << "\" couldn't be saved.\n";
+      last_checkpoint = std::chrono::steady_clock::now();
+    }
+  });
+  progress.Finish();
+  header_ = filter.header();
+  AddRunStatistics(filter.statistics(), statistics_);
+  FinishOutputFile(output, header_.is_present && !output.CanRewriteHeader(), !filtered);
 }
 
-bool Killer::IsNumber(const std::string& word) {
-// Returns "true" if "word" (i.e. a string) is a number and "false" otherwise.
-  int fractional_count = 0;
-  for (unsigned i = 0; i < word.length(); ++i) {
-    if (std::isdigit(word[i]) == 0) {
-      if (i > 0 && fractional_count == 0 && (word[i] == '.' && word[i] == ','))
-        fractional_count = 1;
-      else if (i != 0 || (word[0] != '+' && word[0] != '-'))
-        return false;
+void Killer::FilterFileStream() {
+// Reads "input_file_" as a stream (used if "input_file_" can't be mapped into
+// memory or is gzip compressed) and filters it block by block with a
+// "VectorFilter", just like a program that uses the library. If the input
+// is compressed, it is decompressed on a thread of its own (see
+// "GzipInputStream"), so that decompressing, filtering and (if the output
+// shall be compressed as well) compressing run at the same time.
+  if (options_.duplicate_handling == kKeepLastOccurrence) {
+    // A word vector can't be removed after it has been written.
+    std::cerr << "ERROR: \"" << input_file_ << "\" CAN'T BE DE-DUPLICATED KEEPING THE LAST OCCURRENCES! Only uncompressed regular files can.\n";
+    failed_ = true;
+    return;
+  }
+  const int input_file_descriptor = (input_file_ == "-")? STDIN_FILENO : open(input_file_.c_str(), O_RDONLY);
+  if (input_file_descriptor < 0) {
+    std::cerr << "ERROR: OPENING \"" << input_file_ << "\" FAILED!\n";
+    failed_ = true;
+    return;
+  }
+  // The size of the input file (if it is a regular file) is only needed to
+  // estimate the remaining time.
+  struct stat file_status;
+  const long long input_size = (fstat(input_file_descriptor, &file_status) == 0 && S_ISREG(file_status.st_mode))? file_status.st_size : -1;
+  std::unique_ptr<InputStream> input(new FileInputStream(input_file_descriptor));
+  const std::unique_ptr<OutputStream> output = OpenOutputFile();
+  if (!output) {
+    failed_ = true;
+    return;
+  }
+  // The first block shows whether the input is compressed. If it is, the
+  // compressed data that has been read so far is handed over to the
+  // decompressing thread and the first block is read again.
+  std::vector<char> first_block(std::max(options_.buffer_size, (size_t) 1 << 12));
+  size_t first_block_fill = 0;
+  bool read_failed = false;
+  while (true) {
+    first_block_fill = 0;
+    while (first_block_fill < first_block.size()) {
+      const long long num_of_read_bytes = input->Read(first_block.data()+first_block_fill, first_block.size()-first_block_fill);
+      if (num_of_read_bytes <= 0) {
+        read_failed = num_of_read_bytes < 0;
+        break;
+      }
+      first_block_fill += num_of_read_bytes;
     }
+    if (!IsGzipCompressed(first_block.data(), first_block_fill))
+      break;
+    input.reset(new GzipInputStream(std::move(input), std::string(first_block.data(), first_block_fill)));
+    statistics_.input_is_compressed = true;
+  }
+  VectorFilter filter(*word_filter_, *output, options_);
+  ProgressReporter progress(options_.progress_interval, input_size);
+  filter.Filter(first_block.data(), first_block_fill);
+  if (!read_failed && first_block_fill == first_block.size())
+    read_failed = !filter.Filter(*input, &progress);
+  progress.Finish();
+  if (read_failed) {
+    std::cerr << "ERROR: READING \"" << input_file_ << "\" FAILED!\n";
+    failed_ = true;
   }
+  const bool written = filter.Finish();
+  header_ = filter.header();
+  AddRunStatistics(filter.statistics(), statistics_);
+  FinishOutputFile(*output, false, !written);
+}
+
+std::unique_ptr<OutputStream> Killer::OpenShardFiles() const {
+// Creates the "options_.num_of_shards" shards of "output_file_" (see
+// "GetShardFile()") and returns them as a "ShardedOutputStream" that writes
+// "output_file_.manifest.json" once they are complete.
+  std::vector<std::unique_ptr<OutputStream>> shards;
+  std::vector<std::string> shard_files;
+  for (size_t i = 0; i < options_.num_of_shards; ++i) {
+    shard_files.push_back(GetShardFile(output_file_, i, options_.num_of_shards));
+    const int file_descriptor = open(shard_files.back().c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (file_descriptor < 0) {
+      std::cerr << "ERROR: CREATING \"" << shard_files.back() << "\" FAILED!\n";
+      return NULL;
+    }
+    if (options_.compress_output)
+      shards.emplace_back(new GzipOutputStream(file_descriptor));
+    else
+      shards.emplace_back(new FileOutputStream(file_descriptor));
+  }
+  return std::unique_ptr<OutputStream>(new ShardedOutputStream(std::move(shards), shard_files, output_file_+".manifest.json", options_.shard_by_hash, options_.buffer_size));
+}
+
+std::unique_ptr<OutputStream> Killer::OpenOutputFile(const long long resume_offset) const {
+// Opens (or creates) "output_file_" for writing ("-" stands for the standard
+// output) and returns it as an "OutputStream" that compresses the data if
+// "options_.compress_output" is "true" or converts it into a matrix (and a
+// vocab file next to it) if "options_.write_matrix" is "true" (or "NULL" if
+// opening failed). If a run is resumed, the output file is kept up to
+// "resume_offset" (and cut off there) instead of being emptied. With
+// "options_.num_of_shards" > 1 the shards (and their manifest) are created
+// instead of "output_file_".
+  if (options_.num_of_shards > 1)
+    return OpenShardFiles();
+  const int output_file_descriptor = (output_file_ == "-")? STDOUT_FILENO : (resume_offset >= 0)? open(output_file_.c_str(), O_WRONLY) : open(output_file_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (output_file_descriptor < 0) {
+    std::cerr << "ERROR: CREATING \"" << output_file_ << "\" FAILED!\n";
+    return NULL;
+  }
+  if (resume_offset >= 0 && (ftruncate(output_file_descriptor, resume_offset) != 0 || lseek(output_file_descriptor, resume_offset, SEEK_SET) != resume_offset)) {
+    std::cerr << "ERROR: CUTTING \"" << output_file_ << "\" OFF AT THE CHECKPOINT FAILED!\n";
+    close(output_file_descriptor);
+    return NULL;
+  }
+  if (options_.write_matrix) {
+    const std::string vocab_file = output_file_+".vocab";
+    const int vocab_file_descriptor = open(vocab_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (vocab_file_descriptor < 0) {
+      std::cerr << "ERROR: CREATING \"" << vocab_file << "\" FAILED!\n";
+      close(output_file_descriptor);
+      return NULL;
+    }
+    return std::unique_ptr<OutputStream>(new MatrixOutputStream(std::unique_ptr<OutputStream>(new FileOutputStream(output_file_descriptor)), std::unique_ptr<OutputStream>(new FileOutputStream(vocab_file_descriptor)), output_file_, options_.use_float16));
+  }
+  // A resumed output file continues behind the checkpoint, but its header
+  // line is still at the beginning.
+  const long long header_offset = (resume_offset >= 0)? 0 : GetRewritableOffset(output_file_descriptor);
+  if (options_.compress_output)
+    return std::unique_ptr<OutputStream>(new GzipOutputStream(output_file_descriptor, header_offset));
+  return std::unique_ptr<OutputStream>(new FileOutputStream(output_file_descriptor, header_offset));
+}
+
+bool Killer::LoadValidCheckpoint(const MappedFile& input, const FunctionWordSet& function_words_to_remove, RunCheckpoint& checkpoint) {
+// Loads the checkpoint of an interrupted run on "output_file_" and returns
+// "true" if the run can be continued from it. Without a checkpoint the run
+// starts from the beginning; if the checkpoint doesn't fit the input file,
+// the settings or the output file, "failed_" is set and the output file is
+// left as it is.
+  const std::string checkpoint_file = GetCheckpointFile(output_file_);
+  if (access(checkpoint_file.c_str(), F_OK) != 0) {
+    std::cout << "\tNo checkpoint (\"" << checkpoint_file << "\") found - starting from the beginning." << std::endl;
+    return false;
+  }
+  struct stat output_status;
+  std::string problem;
+  if (!LoadCheckpoint(checkpoint_file, checkpoint))
+    problem = "it is damaged";
+  else if (checkpoint.input_size != input.size() || checkpoint.input_modification_time != GetModificationTime(input_file_) || checkpoint.input_offset > input.size() || checkpoint.input_checksum != GetInputChecksum(input.data(), input.data()+checkpoint.input_offset))
+    problem = "the input file has changed";
+  else if (checkpoint.settings != GetSettingsFingerprint(function_words_to_remove) || checkpoint.function_word_was_removed.size() != function_words_to_remove.size())
+    problem = "the run was started with other settings";
+  else if (stat(output_file_.c_str(), &output_status) != 0 || (uint64_t) output_status.st_size < checkpoint.output_offset)
+    problem = "the output file is shorter than recorded";
+  if (!problem.empty()) {
+    std::cerr << "ERROR: THE RUN CAN'T BE RESUMED FROM \"" << checkpoint_file << "\" - " << problem << "!\n";
+    failed_ = true;
+    return false;
+  }
+  std::cout << "\tResuming the run at byte " << checkpoint.input_offset << " of " << input.size() << " (" << checkpoint.statistics.num_of_checked_vectors << " word vectors checked)." << std::endl;
   return true;
 }
+
+bool Killer::SaveRunCheckpoint(const MappedFile& input, const FunctionWordSet& function_words_to_remove, VectorFilter& filter) const {
+// Writes everything that is pending, syncs the output file and saves a
+// checkpoint at the position "filter" has reached in the input.
+  RunCheckpoint checkpoint;
+  if (!filter.GetState(checkpoint))
+    return false;
+  checkpoint.input_size = input.size();
+  checkpoint.input_modification_time = GetModificationTime(input_file_);
+  checkpoint.input_checksum = GetInputChecksum(input.data(), input.data()+checkpoint.input_offset);
+  checkpoint.settings = GetSettingsFingerprint(function_words_to_remove);
+  return SaveCheckpoint(GetCheckpointFile(output_file_), checkpoint);
+}
+
+uint64_t Killer::GetSettingsFingerprint(const FunctionWordSet& function_words_to_remove) const {
+// Returns a fingerprint of everything that decides which word vectors are
+// kept (the function words with their categories and the options), so that
+// a run is only resumed with the settings it was started with.
+  std::string settings = std::to_string(selected_categories_)+' '+std::to_string(GetTokenRules(selected_categories_, options_))+' '+std::to_string(options_.min_word_length)+' '+std::to_string(options_.max_word_length)+' '+std::to_string(options_.match_compounds)+' '+std::to_string(options_.remove_only_first_occurrence);
+  for (size_t i = 0; i < function_words_to_remove.size(); ++i) {
+    settings += ' ';
+    settings += function_words_to_remove.word(i);
+    settings += ':'+std::to_string(function_words_to_remove.category_mask(i));
+  }
+  return WordFingerprintSet::Fingerprint(settings);
+}
+
+void Killer::FinishOutputFile(OutputStream& output, const bool header_is_final, const bool write_failed) {
+// Sets the correct number of word vectors in the header line (if there is one
+// and it isn't final already) and closes the output file (everything else
+// has been written by the "VectorFilter" already).
+  const long long num_of_kept_vectors = statistics_.num_of_checked_vectors-statistics_.num_of_removed_vectors;
+  const auto start = std::chrono::steady_clock::now();
+  if (header_.is_present && !header_is_final && options_.num_of_shards <= 1) { // shards set their own header lines
+    const std::string header = FormatVectorFileHeader(num_of_kept_vectors, header_);
+    if (header.length() != header_.length || !output.RewriteHeader(header))
+      std::cerr << "WARNING: The header line of \"" << output_file_ << "\" couldn't be set to " << num_of_kept_vectors << " word vectors.\n";
+  }
+  if (!output.Close() || write_failed) {
+    std::cerr << "ERROR: WRITING \"" << output_file_ << "\" FAILED!\n";
+    failed_ = true;
+  }
+  // Closing includes waiting for the compressing thread (if any).
+  statistics_.write_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+}
@@ -14,78 +14,351 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-#include <fstream>
+#include <algorithm>
 #include <iostream>
 #include <regex>
+#include <sstream>
+
+#include <unistd.h>
 
 #include "function_word_vector_killer.h"
 
-std::string SetToLowerCase(std::string string) {
-// Sets every character of a string to lower case and returns the string as a
-// whole.
-  for (auto& character : string)
-    character = tolower(character);
-  return string;
+bool SelectCategories(const std::string& categories, std::vector<bool>& words_to_remove) {
+// Sets "words_to_remove" according to a comma-separated list of categories
+// (given by their number from 1 to 10 or by (the beginning of) the name of
+// their txt-file, e.g. "1,articles,personal") and returns "false" if a
+// category is unknown.
+  std::stringstream stream(categories);
+  std::string category;
+  while (std::getline(stream, category, ',')) {
+    category = SetToLowerCase(category);
+    bool is_known = false;
+    for (unsigned i = 0; i < kCategoryNames.size(); ++i) {
+      if (category == std::to_string(i+1) || (!category.empty() && kCategoryNames[i].compare(0, category.length(), category) == 0)) {
+        words_to_remove[i] = is_known = true;
+        break;
+      }
+    }
+    if (!is_known) {
+      std::cerr << "ERROR: UNKNOWN CATEGORY \"" << category << "\"!\n";
+      return false;
+    }
+  }
+  return true;
 }
 
-bool FileIsValid(const std::string& file) {
-// Checks if "file" is readable and returns "false" if not and "true" otherwise.
-  const std::ifstream file_stream(file);
-  if (!file_stream.is_open()) {
-    std::cerr << "ERROR: OPENING \"" << file << "\" FAILED! Make sure that the file exists and that the path is correct.\n";
-    return false;
-  } else if (file_stream.bad()) {
-    std::cerr << "ERROR: OPENING \"" << file << "\" FAILED!\n";
-    return false;
+bool SelectTokenRules(const std::string& rules, uint8_t& token_rules) {
+// Sets the bits of the token rules in a comma-separated list (given by (the
+// beginning of) their name, e.g. "numbers,urls,emails") in "token_rules" and
+// returns "false" if a rule is unknown. The length rule is selected by giving
+// a length limit instead.
+  std::stringstream stream(rules);
+  std::string rule;
+  while (std::getline(stream, rule, ',')) {
+    rule = SetToLowerCase(rule);
+    bool is_known = false;
+    for (int i = 0; i < kLengthRule; ++i) {
+      if (!rule.empty() && kTokenRuleNames[i].compare(0, rule.length(), rule) == 0) {
+        token_rules |= 1 << i;
+        is_known = true;
+        break;
+      }
+    }
+    if (!is_known) {
+      std::cerr << "ERROR: UNKNOWN TOKEN RULE \"" << rule << "\"!\n";
+      return false;
+    }
   }
   return true;
 }
 
 int main(int argc, char* argv[]) {
-  if (argc == 2 || argc == 3) {
-    if (!FileIsValid(argv[1])) { // checks if the input file is readable
+  // Separates the options (e.g. "--threads 4") from the file arguments. The
+  // language and the categories can be given as options as well (so that the
+  // program can run without asking any questions, e.g. in a pipeline).
+  KillerOptions options;
+  options.progress_interval = (isatty(STDERR_FILENO))? 1 : 0; // progress lines would only clutter log files
+  std::vector<std::string> files;
+  std::string input_file, output_file, language, categories, dictionary_to_compile, output_directory, input_list_file, token_rules;
+  bool remove_all_categories = false, roll_back_in_place = false;
+  for (int i = 1; i < argc; ++i) {
+    const std::string argument = argv[i];
+    const bool has_value = i+1 < argc;
+    if (argument == "--threads" && has_value && std::regex_match(argv[i+1], (std::regex) "[1-9][0-9]{0,3}"))
+      options.num_of_threads = std::stoi(argv[++i]);
+    else if (argument == "--first-occurrence-only")
+      options.remove_only_first_occurrence = true;
+    else if ((argument == "-i" || argument == "--input") && has_value)
+      input_file = argv[++i];
+    else if ((argument == "-o" || argument == "--output") && has_value)
+      output_file = argv[++i];
+    else if (argument == "--lang" && has_value)
+      language = argv[++i];
+    else if (argument == "--categories" && has_value)
+      categories = argv[++i];
+    else if (argument == "--all")
+      remove_all_categories = true;
+    else if (argument == "--gzip")
+      options.compress_output = true;
+    else if (argument == "--buffer-size" && has_value && std::regex_match(argv[i+1], (std::regex) "[1-9][0-9]{0,9}[kKmM]?")) {
+      const std::string size = argv[++i];
+      const char unit = tolower(size.back());
+      options.buffer_size = std::stoull(size)*((unit == 'k')? 1 << 10 : (unit == 'm')? 1 << 20 : 1);
+    } else if (argument == "--progress" && has_value && std::regex_match(argv[i+1], (std::regex) "[0-9]{1,5}(\\.[0-9]+)?"))
+      options.progress_interval = std::stod(argv[++i]);
+    else if (argument == "--stats-json" && has_value)
+      options.statistics_file = argv[++i];
+    else if (argument == "--data" && has_value)
+      options.data_directory = argv[++i];
+    else if (argument == "--dict" && has_value)
+      options.dictionary_file = argv[++i];
+    else if (argument == "--compile-dict" && has_value)
+      dictionary_to_compile = argv[++i];
+    else if (argument == "--output-dir" && has_value)
+      output_directory = argv[++i];
+    else if (argument == "--input-list" && has_value)
+      input_list_file = argv[++i];
+    else if (argument == "--matrix" && has_value && std::regex_match(argv[i+1], (std::regex) "f(32|16)")) {
+      options.write_matrix = true;
+      options.use_float16 = std::string(argv[++i]) == "f16";
+    } else if (argument == "--token-rules" && has_value)
+      token_rules = argv[++i];
+    else if ((argument == "--min-length" || argument == "--max-length") && has_value && std::regex_match(argv[i+1], (std::regex) "[0-9]{1,9}"))
+      ((argument == "--min-length")? options.min_word_length : options.max_word_length) = std::stoul(argv[++i]);
+    else if (argument == "--compounds")
+      options.match_compounds = true;
+    else if (argument == "--dedup" && has_value && std::regex_match(argv[i+1], (std::regex) "first|last"))
+      options.duplicate_handling = (std::string(argv[++i]) == "first")? kKeepFirstOccurrence : kKeepLastOccurrence;
+    else if (argument == "--checkpoint" && has_value && std::regex_match(argv[i+1], (std::regex) "[0-9]{1,6}(\\.[0-9]+)?"))
+      options.checkpoint_interval = std::stod(argv[++i]);
+    else if (argument == "--resume")
+      options.resume = true;
+    else if (argument == "--shards" && has_value && std::regex_match(argv[i+1], (std::regex) "[1-9][0-9]{0,4}"))
+      options.num_of_shards = std::stoul(argv[++i]);
+    else if (argument == "--shard-by" && has_value && std::regex_match(argv[i+1], (std::regex) "size|hash"))
+      options.shard_by_hash = std::string(argv[++i]) == "hash";
+    else if (argument == "--in-place")
+      options.in_place = true;
+    else if (argument == "--rollback-in-place")
+      roll_back_in_place = true;
+    else if (argument.length() > 1 && argument[0] == '-') {
+      std::cerr << "ERROR: INVALID ARGUMENT - \"" << argument << "\" is unknown or needs a value" << ((argument == "--threads")? " (a number of threads between 1 and 9999)" : (argument == "--buffer-size")? " (a number of bytes, e.g. \"4M\" or \"256K\")" : "") << "!\n";
+      std::cout << "Program terminated.";
+      return -1;
+    } else
+      files.push_back(argument);
+  }
+  if (!SelectTokenRules(token_rules, options.token_rules)) {
+    std::cout << "Program terminated.";
+    return -1;
+  }
+  // A resumed run goes on saving checkpoints.
+  if (options.resume && options.checkpoint_interval == 0)
+    options.checkpoint_interval = 60;
+  // Token rules and de-duplication can be used without any category of
+  // function words.
+  const bool has_other_rules = options.token_rules != 0 || options.min_word_length > 0 || options.max_word_length > 0 || options.duplicate_handling != kKeepAllOccurrences;
+  if (!dictionary_to_compile.empty()) {
+    // Compiles the txt-files of a language (or of the "--data" directory)
+    // into a dictionary file for "--dict" instead of checking a file.
+    language = SetToLowerCase(language);
+    if (options.data_directory.empty() && std::regex_match(language, (std::regex) "(eng(lish)?|ger(man)?)"))
+      options.data_directory = (language[0] == 'e')? "data/english" : "data/german";
+    if (options.data_directory.empty()) {
+      std::cerr << "ERROR: MISSING ARGUMENT - \"--compile-dict\" needs \"--lang english|german\" or \"--data [directory]\"!\n";
+      std::cout << "Program terminated.";
+      return -1;
+    }
+    const bool compiled = CompileDictionary(options.data_directory, dictionary_to_compile);
+    std::cout << "Program terminated.";
+    return (compiled)? 0 : -1;
+  }
+  if (options.in_place || roll_back_in_place) {
+    // The input file is changed itself (see "CompactFileInPlace()"). If a
+    // journal shows that this was interrupted before, it is finished (or
+    // rolled back) instead of checking the file again.
+    if (input_file.empty() && !files.empty()) {
+      input_file = files.front();
+      files.erase(files.begin());
+    }
+    if (!output_file.empty() || !files.empty() || !output_directory.empty() || options.compress_output || options.write_matrix || options.checkpoint_interval > 0 || options.num_of_shards > 1 || input_file.empty() || input_file == "-") {
+      std::cerr << "ERROR: INVALID ARGUMENT - \"--in-place\" and \"--rollback-in-place\" need exactly one input file (which must be a regular file) and no output file, \"--output-dir\", \"--gzip\", \"--matrix\", \"--shards\", \"--checkpoint\" or \"--resume\" (they have a journal of their own)!\n";
+      std::cout << "Program terminated.";
+      return -1;
+    }
+    if (roll_back_in_place || InPlaceCompactionIsInterrupted(input_file)) {
+      std::cout << ((roll_back_in_place)? "Rolling back" : "Finishing") << " the interrupted in-place run on \"" << input_file << "\" (recorded in \"" << GetJournalFile(input_file) << "\")..." << std::endl;
+      long long num_of_moved_bytes;
+      const bool finished = FinishInPlaceCompaction(input_file, roll_back_in_place, num_of_moved_bytes);
+      if (finished)
+        std::cout << "\t---Done (" << num_of_moved_bytes << " bytes moved).\n";
+      std::cout << "Program terminated.";
+      return (finished)? 0 : -1;
+    }
+    output_file = input_file;
+  }
+  // With an output directory every file argument (or glob pattern) and every
+  // file in the "--input-list" is an input file (see "RunBatch()").
+  std::vector<std::string> batch_input_files;
+  const bool is_batch = !output_directory.empty();
+  if (!is_batch && !input_list_file.empty()) {
+    std::cerr << "ERROR: MISSING ARGUMENT - \"--input-list\" needs \"--output-dir\"!\n";
+    std::cout << "Program terminated.";
+    return -1;
+  }
+  if (is_batch) {
+    if (!input_file.empty())
+      files.insert(files.begin(), input_file);
+    if (!output_file.empty()) {
+      std::cerr << "ERROR: INVALID ARGUMENT - \"--output\" can't be combined with \"--output-dir\"!\n";
       std::cout << "Program terminated.";
       return -1;
     }
-    const std::string output_file = (argc == 3)? argv[2] : "default_output.txt";
-    std::cout << "Input file: \"" << argv[1] << "\"\n";
-    std::cout << "Output file: \"" << output_file << "\"\n";
-    std::string language;
-    std::cout << "\nDo you want to remove English or German function words?\n(Enter \"english\" or \"german\".) ";
-    std::cin >> language;
+    if (!CollectInputFiles(files, input_list_file, batch_input_files)) {
+      std::cout << "Program terminated.";
+      return -1;
+    }
+    if (std::find(batch_input_files.begin(), batch_input_files.end(), "-") != batch_input_files.end()) {
+      std::cerr << "ERROR: INVALID ARGUMENT - The standard input can't be part of a batch of files!\n";
+      std::cout << "Program terminated.";
+      return -1;
+    }
+    files.clear();
+    input_file = (batch_input_files.empty())? "" : batch_input_files.front();
+  }
+  if (input_file.empty() && !files.empty()) {
+    input_file = files.front();
+    files.erase(files.begin());
+  }
+  if (output_file.empty() && !files.empty()) {
+    output_file = files.front();
+    files.erase(files.begin());
+  }
+  if (!input_file.empty() && files.empty()) {
+    // If the word vectors are written to the standard output, all messages
+    // are written to the standard error output instead.
+    if (output_file == "-")
+      std::cout.rdbuf(std::cerr.rdbuf());
+    if (!is_batch && input_file != "-" && !FileIsValid(input_file)) { // checks if the input file is readable
+      std::cout << "Program terminated.";
+      return -1;
+    }
+    // A dictionary or a directory of txt-files replaces the language.
+    const bool language_is_needed = options.dictionary_file.empty() && options.data_directory.empty();
+    if (input_file == "-" && ((language.empty() && language_is_needed) || (categories.empty() && !remove_all_categories && !has_other_rules))) {
+      std::cerr << "ERROR: MISSING ARGUMENT - If the word vectors are read from the standard input, \"--lang\" (or \"--dict\") and \"--categories\" (or \"--all\") are needed!\n";
+      std::cout << "Program terminated.";
+      return -1;
+    }
+    if (output_file.empty())
+      output_file = "default_output.txt";
+    if (!is_batch && !options.write_matrix && output_file.length() > 3 && output_file.compare(output_file.length()-3, 3, ".gz") == 0)
+      options.compress_output = true;
+    if (options.write_matrix && (output_file == "-" || options.compress_output)) {
+      std::cerr << "ERROR: INVALID ARGUMENT - A matrix (\"--matrix\") can't be written to the standard output or compressed!\n";
+      std::cout << "Program terminated.";
+      return -1;
+    }
+    if (options.num_of_shards > 1 && (output_file == "-" || options.write_matrix)) {
+      std::cerr << "ERROR: INVALID ARGUMENT - Shards (\"--shards\") can't be written to the standard output or as a matrix!\n";
+      std::cout << "Program terminated.";
+      return -1;
+    }
+    if (is_batch) {
+      std::cout << "Input files: " << batch_input_files.size() << "\n";
+      std::cout << "Output directory: \"" << output_directory << "\"\n";
+    } else {
+      std::cout << "Input file: \"" << input_file << "\"\n";
+      if (options.in_place)
+        std::cout << "Output file: (the input file is changed in place)\n";
+      else
+        std::cout << "Output file: \"" << output_file << "\"\n";
+    }
+    if (language.empty() && language_is_needed) {
+      std::cout << "\nDo you want to remove English or German function words?\n(Enter \"english\" or \"german\".) ";
+      std::cin >> language;
+    }
     language = SetToLowerCase(language);
-    int language_index;
+    int language_index = 0;
     if (std::regex_match(language, (std::regex) "eng(lish)?"))
       language_index = 0;
     else if (std::regex_match(language, (std::regex) "ger(man)?"))
       language_index = 1;
-    else {
+    else if (language_is_needed || !language.empty()) {
       std::cout << "This program works only on English and German function words!\nProgram terminated.";
       return -1;
     }
     const std::vector<std::string> questions = {" 1/10 - Remove adpositions? ", " 2/10 - Remove articles etc.? ", " 3/10 - Remove conjunctions and subjunctions? ", " 4/10 - Remove interjections? ", " 5/10 - Remove interrogative words? ", " 6/10 - Remove numerals? ", " 7/10 - Remove particles? ", " 8/10 - Remove personal pronouns and possessives? ", " 9/10 - Remove temporal words? ", "10/10 - Remove miscellaneous functions words? "};
     std::vector<bool> words_to_remove(10);
-    std::string answer;
-    std::cout << "What words do you want to remove from your word vector file?\n(Answer by entering 'y' for \"yes\", 'a' to skip the other questions and remove all function words or enter every other character for \"no\")\n";
-    for (unsigned i = 0; i < words_to_remove.size(); ++i) {
-      std::cout << questions[i];
-      std::cin >> answer;
-      if (std::regex_match(SetToLowerCase(answer), (std::regex) "a(ll)?")) {
-        std::fill(words_to_remove.begin(), words_to_remove.end(), true);
-        break;
+    if (remove_all_categories)
+      std::fill(words_to_remove.begin(), words_to_remove.end(), true);
+    else if (!categories.empty()) {
+      if (!SelectCategories(categories, words_to_remove)) {
+        std::cout << "Program terminated.";
+        return -1;
+      }
+    } else if (!has_other_rules) {
+      std::string answer;
+      std::cout << "What words do you want to remove from your word vector file?\n(Answer by entering 'y' for \"yes\", 'a' to skip the other questions and remove all function words or enter every other character for \"no\")\n";
+      for (unsigned i = 0; i < words_to_remove.size(); ++i) {
+        std::cout << questions[i];
+        std::cin >> answer;
+        if (std::regex_match(SetToLowerCase(answer), (std::regex) "a(ll)?")) {
+          std::fill(words_to_remove.begin(), words_to_remove.end(), true);
+          break;
+        }
+        words_to_remove[i] = (std::regex_match(SetToLowerCase(answer), (std::regex) "y(es)?"))? true : false;
       }
-      words_to_remove[i] = (std::regex_match(SetToLowerCase(answer), (std::regex) "y(es)?"))? true : false;
     }
-    if (std::find(words_to_remove.begin(), words_to_remove.end(), true) == words_to_remove.end()) // terminates program if no "words_to_remove" were selected
+    bool succeeded = true;
+    if (std::find(words_to_remove.begin(), words_to_remove.end(), true) == words_to_remove.end() && !has_other_rules) // terminates program if no "words_to_remove" were selected
       std::cout << "You didn't select words to remove - so there is nothing to do!\n";
-    else
-      Killer function_word_killer(argv[1], output_file, words_to_remove, language_index); // starts the actual "function word killer"
+    else if (is_batch)
+      succeeded = RunBatch(batch_input_files, output_directory, words_to_remove, language_index, options);
+    else {
+      const Killer function_word_killer(input_file, output_file, words_to_remove, language_index, options); // starts the actual "function word killer"
+      succeeded = !function_word_killer.failed();
+    }
     std::cout << "\nProgram terminated.";
-    return 0;
+    return (succeeded)? 0 : -1;
   }
-  std::cerr << ((argc == 1)? "ERROR: MISSING ARGUMENT - No input file given!\n" : "ERROR: TOO MANY ARGUMENTS - Only one input file needed, an output file is optional!\n");
-  std::cout << "Style of usage:\n\t.\\function_word_killer [input_file_with_word_vectors] [output_file (optional; default = default_output.txt)]\n";
+  std::cerr << ((input_file.empty())? "ERROR: MISSING ARGUMENT - No input file given!\n" : "ERROR: TOO MANY ARGUMENTS - Only one input file needed, an output file is optional!\n");
+  std::cout << "Style of usage:\n\t.\\function_word_killer [input_file_with_word_vectors] [output_file (optional; default = default_output.txt)] [options (optional)]\n";
+  std::cout << "Options:\n";
+  std::cout << "\t-i/--input [file]       input file (\"-\" = standard input)\n";
+  std::cout << "\t-o/--output [file]      output file (\"-\" = standard output)\n";
+  std::cout << "\t--lang [language]       \"english\" or \"german\" (instead of being asked)\n";
+  std::cout << "\t--categories [list]     comma-separated categories to remove, by number (1-10) or name (e.g. \"1,articles,personal\")\n";
+  std::cout << "\t--all                   remove all categories\n";
+  std::cout << "\t--gzip                  gzip compress the output (default for output files ending with \".gz\"; compressed input files are recognized automatically)\n";
+  std::cout << "\t--threads [number]      number of threads (default = 1)\n";
+  std::cout << "\t--first-occurrence-only remove only the first word vector of every function word\n";
+  std::cout << "\t--token-rules [list]    also remove words by their form: comma-separated rules out of \"numbers\" (always used with the numerals), \"ordinals\", \"punctuation\" (ASCII and UTF-8), \"urls\" and \"emails\"\n";
+  std::cout << "\t--min-length [number]   also remove words with less characters\n";
+  std::cout << "\t--max-length [number]   also remove words with more characters\n";
+  std::cout << "\t--compounds             also remove compound words of the selected function words joined by '_' or '-' (e.g. \"as_well_as\")\n";
+  std::cout << "\t--dedup [first|last]    also remove all word vectors of a word that occurs several times but the first (or last) one\n";
+  std::cout << "\t--checkpoint [seconds]  save a checkpoint of the run every few seconds (in \"<output_file>.fwvk-checkpoint\"), so that it can be resumed\n";
+  std::cout << "\t--resume                continue an interrupted run from its checkpoint (and go on saving checkpoints; default = every 60 seconds)\n";
+  std::cout << "\t--buffer-size [bytes]   size of the read blocks and writes (e.g. \"256K\"; default = 4M)\n";
+  std::cout << "\t--progress [seconds]    print a progress line every few seconds (0 = never; default = 1 on a terminal, otherwise 0)\n";
+  std::cout << "\t--stats-json [file]     write counters and timings of the run as JSON to \"file\"\n";
+  std::cout << "\t--data [directory]      directory with the txt-files of the function words (instead of \"data/<language>\")\n";
+  std::cout << "\t--compile-dict [file]   compile the txt-files of \"--lang\" (or \"--data\") into a dictionary file and exit\n";
+  std::cout << "\t--dict [file]           use a compiled dictionary file instead of the txt-files\n";
+  std::cout << "\t--output-dir [directory] check all input files (file names or quoted glob patterns) and write the results into \"directory\"\n";
+  std::cout << "\t--input-list [file]     file with the names of further input files (one per line; needs \"--output-dir\")\n";
+  std::cout << "\t--matrix [f32|f16]      write the kept word vectors as a packed float32 (or float16) matrix that can be mapped into memory and their words into \"<output_file>.vocab\"\n";
+  std::cout << "\t--shards [number]       split the kept word vectors among that many files (\"<output_file>-00000-of-0000N\" etc., each with its own header line) and list them in \"<output_file>.manifest.json\"\n";
+  std::cout << "\t--shard-by [size|hash]  fill the shards in turns with blocks of \"--buffer-size\" bytes (default) or by a hash of the word, so that a word always ends up in the same shard\n";
+  std::cout << "\t--in-place              remove the word vectors from the input file itself instead of writing an output file (finishes an interrupted run first)\n";
+  std::cout << "\t--rollback-in-place     restore the input file of an interrupted \"--in-place\" run and exit\n";
   std::cout << "Example usage:\n\t.\\function_word_killer my_word_vectors.txt my_important_word_vectors.txt\n";
+  std::cout << "\t.\\function_word_killer --compile-dict english.dict --lang english\n";
+  std::cout << "\t.\\function_word_killer my_word_vectors.txt my_important_word_vectors.txt --dict english.dict --all\n";
+  std::cout << "\t.\\function_word_killer \"shards/*.txt\" --output-dir cleaned_shards --dict english.dict --all --threads 8\n";
+  std::cout << "\t.\\function_word_killer my_word_vectors.txt --in-place --lang english --all\n";
+  std::cout << "\tzstdcat my_word_vectors.txt.zst | .\\function_word_killer -i - -o - --lang english --all | zstd > my_important_word_vectors.txt.zst\n";
   std::cout << "Program terminated.";
   return -1;
 }
@@ -0,0 +1,85 @@
+// mapped_file.cc
+
+// Copyright 2019 E. Decker
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "function_word_vector_killer.h"
+
+MappedFile::MappedFile(const std::string& file, const MappedFileAccess access) : data_(NULL), size_(0) {
+  // "-" stands for the standard input, which can be mapped as well if it is
+  // redirected from a regular file.
+  const int file_descriptor = (file == "-")? STDIN_FILENO : open(file.c_str(), O_RDONLY);
+  if (file_descriptor < 0)
+    return;
+  struct stat file_status;
+  // Only regular files can be mapped; pipes, sockets and the like have to be
+  // read as streams.
+  if (fstat(file_descriptor, &file_status) == 0 && S_ISREG(file_status.st_mode)) {
+    if (file_status.st_size == 0) {
+      data_ = ""; // "mmap()" refuses to map empty files, but there is nothing to scan anyway
+    } else {
+      void* mapping = mmap(NULL, file_status.st_size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+      if (mapping != MAP_FAILED) {
+        data_ = static_cast<const char*>(mapping);
+        size_ = file_status.st_size;
+        // Input files are read exactly once from front to back, whereas e.g.
+        // a dictionary is probed at random positions (where reading ahead
+        // would only load pages that aren't needed).
+        madvise(mapping, size_, (access == kSequentialAccess)? MADV_SEQUENTIAL : MADV_RANDOM);
+      }
+    }
+  }
+  if (file_descriptor != STDIN_FILENO)
+    close(file_descriptor); // the mapping stays valid after closing the file
+}
+
+MappedFile::~MappedFile() {
+  if (size_ > 0)
+    munmap(const_cast<char*>(data_), size_);
+}
+
+bool WriteAll(const int file_descriptor, const char* data, size_t size) {
+// Writes "size" bytes of "data" to "file_descriptor" (repeating "write()"
+// until everything is written) and returns "false" if that failed.
+  while (size > 0) {
+    const ssize_t written = write(file_descriptor, data, size);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    data += written;
+    size -= written;
+  }
+  return true;
+}
+
+bool SyncDirectoryOf(const std::string& file) {
+// Syncs the directory that contains "file", so that a file that was just
+// created or renamed there survives a crash. Returns "false" if that failed.
+  const size_t last_slash = file.find_last_of('/');
+  const int directory = open((last_slash == std::string::npos)? "." : file.substr(0, last_slash+1).c_str(), O_RDONLY);
+  if (directory < 0)
+    return false;
+  const bool synced = fsync(directory) == 0;
+  close(directory);
+  return synced;
+}
@@ -0,0 +1,218 @@
+// matrix_output.cc
+
+// Copyright 2019 E. Decker
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "function_word_vector_killer.h"
+
+namespace {
+
+const char kMatrixMagic[8] = {'F', 'W', 'V', 'K', 'M', 'T', 'R', 'X'};
+const uint32_t kMatrixVersion = 1;
+const uint32_t kByteOrderMark = 0x01020304;
+static_assert(sizeof(MatrixFileHeader) == 64, "the header of a matrix file must not contain padding");
+
+const size_t kMaxBufferSize = 1 << 22; // the buffers are written once they are bigger
+
+uint16_t FloatToHalf(const float value) {
+// Converts "value" to an IEEE 754 half precision value (rounded to nearest,
+// ties to even; values that are too big become infinite).
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  const uint16_t sign = (bits >> 16) & 0x8000;
+  const int biased_exponent = (bits >> 23) & 0xff;
+  uint32_t mantissa = bits & 0x7fffff;
+  if (biased_exponent == 0xff) // infinite or not a number
+    return sign | 0x7c00 | ((mantissa != 0)? 0x200 : 0);
+  const int exponent = biased_exponent-127+15;
+  if (exponent >= 31)
+    return sign | 0x7c00;
+  uint32_t half, remainder, halfway;
+  if (exponent <= 0) { // a subnormal half (or zero)
+    if (exponent < -10)
+      return sign;
+    mantissa |= 0x800000;
+    const int shift = 14-exponent;
+    half = mantissa >> shift;
+    remainder = mantissa & ((1u << shift)-1);
+    halfway = 1u << (shift-1);
+  } else {
+    half = (exponent << 10) | (mantissa >> 13);
+    remainder = mantissa & 0x1fff;
+    halfway = 0x1000;
+  }
+  if (remainder > halfway || (remainder == halfway && (half & 1))) // a carry into the exponent is correct as well
+    half++;
+  return sign | half;
+}
+
+}  // namespace
+
+MatrixOutputStream::MatrixOutputStream(std::unique_ptr<OutputStream> matrix, std::unique_ptr<OutputStream> vocab, const std::string& matrix_file, const bool use_float16)
+    : matrix_(std::move(matrix)),
+      vocab_(std::move(vocab)),
+      matrix_file_(matrix_file),
+      use_float16_(use_float16),
+      num_of_rows_(0),
+      failed_(false),
+      is_closed_(false) {
+  // Keeps the place of the header, which is written when the number of rows
+  // is known.
+  matrix_buffer_.resize(sizeof(MatrixFileHeader), '\0');
+}
+
+MatrixOutputStream::~MatrixOutputStream() {
+  Close();
+}
+
+bool MatrixOutputStream::Write(const char* data, const size_t size) {
+// The data doesn't need to end at the end of a word vector; the rest is kept
+// until the next call.
+  if (failed_)
+    return false;
+  if (pending_.empty()) {
+    const size_t num_of_parsed_bytes = ParseVectors(data, data+size, false);
+    pending_.assign(data+num_of_parsed_bytes, size-num_of_parsed_bytes);
+  } else {
+    pending_.append(data, size);
+    pending_.erase(0, ParseVectors(pending_.data(), pending_.data()+pending_.size(), false));
+  }
+  return !failed_ && FlushBuffers();
+}
+
+size_t MatrixOutputStream::ParseVectors(const char* begin, const char* end, const bool is_end_of_input) {
+// Adds every complete word vector between "begin" and "end" to the matrix
+// and returns the number of bytes they take.
+  const char* vector_begin = begin;
+  while (vector_begin < end && !failed_) {
+    if (input_format_.is_binary) {
+      if (*vector_begin == '\n') { // the newline that might follow a binary word vector
+        vector_begin++;
+        continue;
+      }
+      const char* word_end = static_cast<const char*>(memchr(vector_begin, ' ', end-vector_begin));
+      const size_t values_size = 4*input_format_.dimension;
+      if (word_end == NULL || (size_t) (end-word_end-1) < values_size)
+        break;
+      values_.resize(input_format_.dimension);
+      memcpy(values_.data(), word_end+1, values_size);
+      AddRow(vector_begin, word_end);
+      vector_begin = word_end+1+values_size;
+      continue;
+    }
+    const char* line_end = static_cast<const char*>(memchr(vector_begin, '\n', end-vector_begin));
+    if (line_end == NULL && !is_end_of_input)
+      break;
+    const char* next_vector = (line_end == NULL)? end : line_end+1;
+    if (line_end == NULL)
+      line_end = end;
+    if (line_end > vector_begin && line_end[-1] == '\r')
+      line_end--;
+    const char* word_end = FindWordEnd(vector_begin, line_end);
+    values_.clear();
+    for (const char* it = word_end; it < line_end;) {
+      if (*it == ' ' || *it == '\t') {
+        it++;
+        continue;
+      }
+      float value;
+      const std::from_chars_result result = std::from_chars(it, line_end, value);
+      if (result.ec == std::errc::result_out_of_range) // e.g. "1e-50", which "strtof()" rounds
+        value = strtof(std::string(it, result.ptr).c_str(), NULL);
+      else if (result.ec != std::errc()) {
+        std::cerr << "ERROR: \"" << std::string(it, std::min(line_end, it+20)) << "\" IN THE WORD VECTOR OF \"" << std::string(vector_begin, word_end) << "\" IS NO NUMBER!\n";
+        failed_ = true;
+        break;
+      }
+      values_.push_back(value);
+      it = result.ptr;
+    }
+    if (!failed_ && (word_end > vector_begin || !values_.empty())) // empty lines are skipped
+      AddRow(vector_begin, word_end);
+    vector_begin = next_vector;
+  }
+  return vector_begin-begin;
+}
+
+bool MatrixOutputStream::AddRow(const char* word_begin, const char* word_end) {
+// Adds the word and the "values_" of a word vector to the buffers.
+  if (input_format_.dimension == 0)
+    input_format_.dimension = values_.size(); // the first word vector of a file without header line
+  if ((long long) values_.size() != input_format_.dimension) {
+    std::cerr << "ERROR: THE WORD VECTOR OF \"" << std::string(word_begin, word_end) << "\" (ROW " << num_of_rows_+1 << ") HAS " << values_.size() << " VALUES INSTEAD OF " << input_format_.dimension << "!\n";
+    failed_ = true;
+    return false;
+  }
+  vocab_buffer_.insert(vocab_buffer_.end(), word_begin, word_end);
+  vocab_buffer_.push_back('\n');
+  const size_t row_begin = matrix_buffer_.size();
+  if (use_float16_) {
+    matrix_buffer_.resize(row_begin+2*values_.size());
+    uint16_t* row = reinterpret_cast<uint16_t*>(matrix_buffer_.data()+row_begin);
+    for (size_t i = 0; i < values_.size(); ++i)
+      row[i] = FloatToHalf(values_[i]);
+  } else {
+    matrix_buffer_.resize(row_begin+4*values_.size());
+    memcpy(matrix_buffer_.data()+row_begin, values_.data(), 4*values_.size());
+  }
+  num_of_rows_++;
+  return true;
+}
+
+bool MatrixOutputStream::FlushBuffers() {
+// Writes the buffers once they are big enough (which keeps the number of
+// writes low without holding the whole matrix in memory).
+  if (matrix_buffer_.size() >= kMaxBufferSize) {
+    failed_ |= !matrix_->Write(matrix_buffer_.data(), matrix_buffer_.size());
+    matrix_buffer_.clear();
+  }
+  if (vocab_buffer_.size() >= kMaxBufferSize) {
+    failed_ |= !vocab_->Write(vocab_buffer_.data(), vocab_buffer_.size());
+    vocab_buffer_.clear();
+  }
+  return !failed_;
+}
+
+bool MatrixOutputStream::Close() {
+// Parses the last word vector (if its line isn't terminated), writes what is
+// left in the buffers and sets the number of rows in the header of the matrix.
+  if (is_closed_)
+    return !failed_;
+  is_closed_ = true;
+  if (!failed_ && !pending_.empty() && ParseVectors(pending_.data(), pending_.data()+pending_.size(), true) != pending_.size()) {
+    std::cerr << "ERROR: THE LAST WORD VECTOR WRITTEN TO \"" << matrix_file_ << "\" IS INCOMPLETE!\n";
+    failed_ = true;
+  }
+  if (!failed_ && ((!matrix_buffer_.empty() && !matrix_->Write(matrix_buffer_.data(), matrix_buffer_.size())) || (!vocab_buffer_.empty() && !vocab_->Write(vocab_buffer_.data(), vocab_buffer_.size()))))
+    failed_ = true;
+  MatrixFileHeader header = {};
+  memcpy(header.magic, kMatrixMagic, sizeof(kMatrixMagic));
+  header.version = kMatrixVersion;
+  header.byte_order = kByteOrderMark;
+  header.num_of_rows = num_of_rows_;
+  header.dimension = input_format_.dimension;
+  header.value_size = (use_float16_)? 2 : 4;
+  header.data_offset = sizeof(MatrixFileHeader);
+  // Without a valid header the matrix can't be mistaken for a complete one.
+  if (!failed_ && !matrix_->RewriteHeader(std::string(reinterpret_cast<const char*>(&header), sizeof(header))))
+    failed_ = true;
+  const bool matrix_is_closed = matrix_->Close(), vocab_is_closed = vocab_->Close();
+  failed_ |= !matrix_is_closed || !vocab_is_closed;
+  return !failed_;
+}
@@ -0,0 +1,59 @@
+// range_writer.cc
+
+// Copyright 2019 E. Decker
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+
+#include "function_word_vector_killer.h"
+
+RangeWriter::RangeWriter(OutputStream& output, const size_t max_write_size)
+    : output_(output),
+      max_write_size_(std::max(max_write_size, (size_t) 1)),
+      pending_range_begin_(NULL),
+      pending_range_end_(NULL),
+      num_of_written_bytes_(0),
+      num_of_writes_(0),
+      write_seconds_(0),
+      failed_(false) {}
+
+void RangeWriter::Write(const char* begin, const char* end) {
+// Adds the range between "begin" and "end" to the range that is about to be
+// written if it directly follows it, otherwise writes the pending range and
+// keeps the new one pending.
+  if (begin == end)
+    return;
+  if (begin != pending_range_end_) {
+    Flush();
+    pending_range_begin_ = begin;
+  }
+  pending_range_end_ = end;
+}
+
+bool RangeWriter::Flush() {
+// Writes the pending range (which must be done before the memory it points
+// to becomes invalid) and returns "false" if anything couldn't be written.
+  const auto start = std::chrono::steady_clock::now();
+  for (const char* it = pending_range_begin_; it != pending_range_end_ && !failed_;) {
+    const size_t size = std::min((size_t) (pending_range_end_-it), max_write_size_);
+    if (!output_.Write(it, size))
+      failed_ = true;
+    num_of_written_bytes_ += size;
+    num_of_writes_++;
+    it += size;
+  }
+  write_seconds_ += std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+  pending_range_begin_ = pending_range_end_ = NULL;
+  return !failed_;
+}
@@ -0,0 +1,161 @@
+// run_statistics.cc
+
+// Copyright 2019 E. Decker
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#include <unistd.h>
+
+#include "function_word_vector_killer.h"
+
+std::string QuoteJsonString(const std::string& string) {
+// Returns "string" in quotes with the characters escaped that must not appear
+// in a JSON string as they are.
+  std::string quoted = "\"";
+  for (const char character : string) {
+    if (character == '"' || character == '\\') {
+      quoted += '\\';
+      quoted += character;
+    } else if (static_cast<unsigned char>(character) < 0x20) {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", character);
+      quoted += escaped;
+    } else
+      quoted += character;
+  }
+  return quoted+'"';
+}
+
+namespace {
+
+std::string FormatDuration(const double seconds) {
+// Formats "seconds" like "1:02:03".
+  const long long total = (long long) (seconds+0.5);
+  char formatted[32];
+  snprintf(formatted, sizeof(formatted), "%lld:%02lld:%02lld", total/3600, total/60%60, total%60);
+  return formatted;
+}
+
+}  // namespace
+
+void AddRunStatistics(const RunStatistics& statistics, RunStatistics& sum) {
+// Adds the counters and times of "statistics" to "sum" (e.g. to sum up the
+// runs of a batch of files).
+  if (sum.input_format.empty())
+    sum.input_format = statistics.input_format;
+  else if (sum.input_format != statistics.input_format)
+    sum.input_format = "mixed";
+  sum.input_is_compressed |= statistics.input_is_compressed;
+  sum.buffer_size = std::max(sum.buffer_size, statistics.buffer_size);
+  sum.num_of_read_bytes += statistics.num_of_read_bytes;
+  sum.num_of_written_bytes += statistics.num_of_written_bytes;
+  sum.num_of_writes += statistics.num_of_writes;
+  sum.num_of_checked_vectors += statistics.num_of_checked_vectors;
+  sum.num_of_removed_vectors += statistics.num_of_removed_vectors;
+  for (int i = 0; i < kNumOfTokenRules; ++i)
+    sum.num_of_removed_vectors_per_rule[i] += statistics.num_of_removed_vectors_per_rule[i];
+  sum.num_of_removed_compounds += statistics.num_of_removed_compounds;
+  sum.num_of_removed_duplicates += statistics.num_of_removed_duplicates;
+  for (int i = 0; i < kNumOfCategories; ++i)
+    sum.num_of_removed_vectors_per_category[i] += statistics.num_of_removed_vectors_per_category[i];
+  sum.lookup_seconds += statistics.lookup_seconds;
+  sum.token_rule_seconds += statistics.token_rule_seconds;
+  sum.write_seconds += statistics.write_seconds;
+  sum.total_seconds += statistics.total_seconds;
+}
+
+bool WriteRunStatistics(const RunStatistics& statistics, const std::string& input_file, const std::string& output_file, const std::string& statistics_file) {
+// Writes "statistics" as a JSON object to "statistics_file" (so that runs can
+// be compared by scripts) and returns "false" if that failed.
+  std::ofstream file_stream(statistics_file);
+  if (!file_stream.is_open()) {
+    std::cerr << "ERROR: CREATING \"" << statistics_file << "\" FAILED!\n";
+    return false;
+  }
+  const double seconds = std::max(statistics.total_seconds, 1e-9);
+  file_stream << "{\n";
+  file_stream << "  \"input_file\": " << QuoteJsonString(input_file) << ",\n";
+  file_stream << "  \"output_file\": " << QuoteJsonString(output_file) << ",\n";
+  file_stream << "  \"input_format\": " << QuoteJsonString(statistics.input_format) << ",\n";
+  file_stream << "  \"input_is_compressed\": " << (statistics.input_is_compressed? "true" : "false") << ",\n";
+  file_stream << "  \"threads\": " << statistics.num_of_threads << ",\n";
+  file_stream << "  \"buffer_size\": " << statistics.buffer_size << ",\n";
+  file_stream << "  \"read_bytes\": " << statistics.num_of_read_bytes << ",\n";
+  file_stream << "  \"written_bytes\": " << statistics.num_of_written_bytes << ",\n";
+  file_stream << "  \"writes\": " << statistics.num_of_writes << ",\n";
+  file_stream << "  \"checked_vectors\": " << statistics.num_of_checked_vectors << ",\n";
+  file_stream << "  \"removed_vectors\": " << statistics.num_of_removed_vectors << ",\n";
+  file_stream << "  \"kept_vectors\": " << statistics.num_of_checked_vectors-statistics.num_of_removed_vectors << ",\n";
+  file_stream << "  \"removed_vectors_per_rule\": {";
+  for (int i = 0; i < kNumOfTokenRules; ++i)
+    file_stream << ((i > 0)? ", " : "") << QuoteJsonString(kTokenRuleNames[i]) << ": " << statistics.num_of_removed_vectors_per_rule[i];
+  file_stream << "},\n";
+  file_stream << "  \"removed_compounds\": " << statistics.num_of_removed_compounds << ",\n";
+  file_stream << "  \"removed_duplicates\": " << statistics.num_of_removed_duplicates << ",\n";
+  file_stream << "  \"removed_vectors_per_category\": {";
+  for (int i = 0; i < kNumOfCategories; ++i)
+    file_stream << ((i > 0)? ", " : "") << QuoteJsonString(kCategoryNames[i]) << ": " << statistics.num_of_removed_vectors_per_category[i];
+  file_stream << "},\n";
+  file_stream << "  \"seconds\": {\"total\": " << statistics.total_seconds << ", \"lookup\": " << statistics.lookup_seconds << ", \"token_rules\": " << statistics.token_rule_seconds << ", \"write\": " << statistics.write_seconds << "},\n";
+  file_stream << "  \"megabytes_per_second\": " << statistics.num_of_read_bytes/seconds/1e6 << ",\n";
+  file_stream << "  \"vectors_per_second\": " << statistics.num_of_checked_vectors/seconds << "\n";
+  file_stream << "}\n";
+  file_stream.close();
+  if (file_stream.fail()) {
+    std::cerr << "ERROR: WRITING \"" << statistics_file << "\" FAILED!\n";
+    return false;
+  }
+  return true;
+}
+
+ProgressReporter::ProgressReporter(const double interval, const long long input_size)
+    : interval_(interval),
+      input_size_(input_size),
+      start_(std::chrono::steady_clock::now()),
+      is_terminal_(isatty(STDERR_FILENO)),
+      next_report_(interval),
+      has_reported_(false) {}
+
+void ProgressReporter::Update(const long long num_of_consumed_bytes, const long long num_of_read_bytes, const long long num_of_checked_vectors) {
+// Prints a progress line if "interval_" seconds have passed since the last
+// one. "num_of_consumed_bytes" is the position in the input file (which is
+// compared to "input_size_"), "num_of_read_bytes" the number of (decompressed)
+// bytes checked so far.
+  if (interval_ <= 0)
+    return;
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()-start_).count();
+  if (seconds < next_report_)
+    return;
+  next_report_ = seconds+interval_;
+  char line[160];
+  int length = snprintf(line, sizeof(line), "\tProgress: %.1f MB, %lld word vectors, %.1f MB/s", num_of_read_bytes/1e6, num_of_checked_vectors, num_of_read_bytes/seconds/1e6);
+  if (input_size_ > 0 && num_of_consumed_bytes > 0) {
+    const double fraction = std::min((double) num_of_consumed_bytes/input_size_, 1.0);
+    length += snprintf(line+length, sizeof(line)-length, " (%.1f%%, ETA %s)", 100*fraction, FormatDuration(seconds/fraction-seconds).c_str());
+  }
+  std::cerr << line << ((is_terminal_)? "    \r" : "\n") << std::flush;
+  has_reported_ = true;
+}
+
+void ProgressReporter::Finish() {
+// Ends the progress line on a terminal (so that the next message starts on a
+// line of its own).
+  if (has_reported_ && is_terminal_)
+    std::cerr << '\n';
+  has_reported_ = false;
+}
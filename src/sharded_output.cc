@@ -0,0 +1,207 @@
+// sharded_output.cc
+
+// Copyright 2019 E. Decker
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "function_word_vector_killer.h"
+
+std::string GetShardFile(const std::string& output_file, const size_t index, const size_t num_of_shards) {
+// Returns the name of a shard of "output_file", e.g. "vectors-00001-of-00004.vec.gz"
+// for the second of four shards of "vectors.vec.gz" (the number is inserted in
+// front of the extensions, so that they still tell the format).
+  char number[32];
+  snprintf(number, sizeof(number), "-%05zu-of-%05zu", index, num_of_shards);
+  const size_t name_begin = output_file.find_last_of('/')+1; // 0 if there is no directory
+  const size_t extension_begin = output_file.find('.', name_begin+1);
+  if (extension_begin == std::string::npos)
+    return output_file+number;
+  return output_file.substr(0, extension_begin)+number+output_file.substr(extension_begin);
+}
+
+ShardedOutputStream::ShardedOutputStream(std::vector<std::unique_ptr<OutputStream>> shards, const std::vector<std::string>& shard_files, const std::string& manifest_file, const bool shard_by_hash, const size_t block_size)
+    : manifest_file_(manifest_file),
+      shard_by_hash_(shard_by_hash),
+      block_size_(std::max(block_size, (size_t) 1)),
+      current_shard_(0),
+      failed_(false),
+      is_closed_(false) {
+  for (size_t i = 0; i < shards.size(); ++i) {
+    shards_.emplace_back();
+    shards_.back().output = std::move(shards[i]);
+    shards_.back().file = shard_files[i];
+  }
+}
+
+ShardedOutputStream::~ShardedOutputStream() {
+  Close();
+}
+
+bool ShardedOutputStream::CanRewriteHeader() const {
+  for (const auto& shard : shards_) {
+    if (!shard.output->CanRewriteHeader())
+      return false;
+  }
+  return true;
+}
+
+bool ShardedOutputStream::WriteHeader(const char* data, const size_t size) {
+// Writes the header line to every shard for now; it is replaced by one with
+// the number of word vectors of the shard when closing.
+  header_.assign(data, size);
+  for (auto& shard : shards_)
+    failed_ |= !shard.output->WriteHeader(data, size);
+  return !failed_;
+}
+
+bool ShardedOutputStream::Write(const char* data, const size_t size) {
+// The data doesn't need to end at the end of a word vector; the rest is kept
+// until the next call.
+  if (failed_)
+    return false;
+  if (pending_.empty()) {
+    const size_t num_of_split_bytes = SplitVectors(data, data+size, false);
+    pending_.assign(data+num_of_split_bytes, size-num_of_split_bytes);
+  } else {
+    pending_.append(data, size);
+    pending_.erase(0, SplitVectors(pending_.data(), pending_.data()+pending_.size(), false));
+  }
+  return !failed_;
+}
+
+size_t ShardedOutputStream::SplitVectors(const char* begin, const char* end, const bool is_end_of_input) {
+// Adds every complete word vector between "begin" and "end" to its shard and
+// returns the number of bytes they take. A word vector is a line of a text
+// file or a word, a space and "dimension" 4-byte values of a binary file
+// (with the newline that might follow them).
+  const char* vector_begin = begin;
+  while (vector_begin < end && !failed_) {
+    const char* word_end;
+    const char* vector_end;
+    if (input_format_.is_binary) {
+      word_end = static_cast<const char*>(memchr(vector_begin, ' ', end-vector_begin));
+      const size_t values_size = 4*input_format_.dimension;
+      if (word_end == NULL || (size_t) (end-word_end-1) < values_size+((is_end_of_input)? 0 : 1)) // a newline might still follow
+        break;
+      vector_end = word_end+1+values_size;
+      if (vector_end < end && *vector_end == '\n')
+        vector_end++;
+    } else {
+      vector_end = static_cast<const char*>(memchr(vector_begin, '\n', end-vector_begin));
+      if (vector_end == NULL && !is_end_of_input)
+        break;
+      vector_end = (vector_end == NULL)? end : vector_end+1;
+      word_end = FindWordEnd(vector_begin, vector_end);
+    }
+    AddVector(vector_begin, word_end, vector_end);
+    vector_begin = vector_end;
+  }
+  return vector_begin-begin;
+}
+
+void ShardedOutputStream::AddVector(const char* begin, const char* word_end, const char* end) {
+// Adds a word vector to the buffer of the shard of its word (or to the
+// current shard, which is changed after every "block_size_" bytes).
+  size_t index;
+  if (shard_by_hash_)
+    index = WordFingerprintSet::Fingerprint(std::string_view(begin, word_end-begin)) % shards_.size();
+  else {
+    if (shards_[current_shard_].num_of_bytes_in_block >= block_size_) {
+      shards_[current_shard_].num_of_bytes_in_block = 0;
+      current_shard_ = (current_shard_+1) % shards_.size();
+    }
+    index = current_shard_;
+  }
+  Shard& shard = shards_[index];
+  shard.buffer.insert(shard.buffer.end(), begin, end);
+  shard.num_of_vectors++;
+  shard.num_of_bytes_in_block += end-begin;
+  if (shard.buffer.size() >= block_size_)
+    FlushShard(shard);
+}
+
+void ShardedOutputStream::FlushShard(Shard& shard) {
+  if (shard.buffer.empty())
+    return;
+  shard.checksum = crc32(shard.checksum, reinterpret_cast<const Bytef*>(shard.buffer.data()), shard.buffer.size());
+  shard.num_of_bytes += shard.buffer.size();
+  failed_ |= !shard.output->Write(shard.buffer.data(), shard.buffer.size());
+  shard.buffer.clear();
+}
+
+bool ShardedOutputStream::Close() {
+// Splits the last word vector (if its line isn't terminated), writes what is
+// left in the buffers, sets the header line of every shard and writes the
+// manifest. The manifest is written last, so it only exists if all shards
+// are complete.
+  if (is_closed_)
+    return !failed_;
+  is_closed_ = true;
+  if (!failed_ && !pending_.empty() && SplitVectors(pending_.data(), pending_.data()+pending_.size(), true) != pending_.size()) {
+    std::cerr << "ERROR: THE LAST WORD VECTOR WRITTEN TO \"" << shards_[current_shard_].file << "\" IS INCOMPLETE!\n";
+    failed_ = true;
+  }
+  for (auto& shard : shards_) {
+    FlushShard(shard);
+    std::string header = header_;
+    if (!header_.empty()) {
+      header = FormatVectorFileHeader(shard.num_of_vectors, input_format_);
+      if (header.length() != header_.length() || !shard.output->RewriteHeader(header)) {
+        std::cerr << "WARNING: The header line of \"" << shard.file << "\" couldn't be set to " << shard.num_of_vectors << " word vectors.\n";
+        header = header_;
+      }
+    }
+    // The checksum covers the whole (uncompressed) shard, header line included.
+    shard.checksum = crc32_combine(crc32(0, reinterpret_cast<const Bytef*>(header.data()), header.size()), shard.checksum, shard.num_of_bytes);
+    shard.num_of_bytes += header.size();
+    failed_ |= !shard.output->Close();
+  }
+  if (!failed_)
+    failed_ = !WriteManifest();
+  return !failed_;
+}
+
+bool ShardedOutputStream::WriteManifest() const {
+// Writes the list of the shards (by their names, as the manifest is next to
+// them) with their number of word vectors, their (uncompressed) size and the
+// crc32 of their (uncompressed) content as JSON.
+  std::ofstream file_stream(manifest_file_);
+  long long num_of_vectors = 0;
+  for (const auto& shard : shards_)
+    num_of_vectors += shard.num_of_vectors;
+  file_stream << "{\n";
+  file_stream << "  \"format\": " << QuoteJsonString((input_format_.is_binary)? "binary" : "text") << ",\n";
+  file_stream << "  \"dimension\": " << input_format_.dimension << ",\n";
+  file_stream << "  \"shard_by\": " << QuoteJsonString((shard_by_hash_)? "hash" : "size") << ",\n";
+  file_stream << "  \"vectors\": " << num_of_vectors << ",\n";
+  file_stream << "  \"shards\": [\n";
+  for (size_t i = 0; i < shards_.size(); ++i) {
+    char checksum[16];
+    snprintf(checksum, sizeof(checksum), "%08lx", (unsigned long) shards_[i].checksum);
+    const std::string& file = shards_[i].file;
+    file_stream << "    {\"file\": " << QuoteJsonString(file.substr(file.find_last_of('/')+1)) << ", \"vectors\": " << shards_[i].num_of_vectors << ", \"bytes\": " << shards_[i].num_of_bytes << ", \"crc32\": \"" << checksum << "\"}" << ((i+1 < shards_.size())? "," : "") << '\n';
+  }
+  file_stream << "  ]\n";
+  file_stream << "}\n";
+  file_stream.close();
+  if (file_stream.fail()) {
+    std::cerr << "ERROR: WRITING \"" << manifest_file_ << "\" FAILED!\n";
+    return false;
+  }
+  return true;
+}
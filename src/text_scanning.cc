@@ -0,0 +1,154 @@
+// text_scanning.cc
+
+// Copyright 2019 E. Decker
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Functions that are run on the word of every word vector. On x86 processors
+// they look at 16 bytes (SSE2) or - if the processor supports it - 32 bytes
+// (AVX2) at once; the remaining bytes (and everything on other processors)
+// are handled one by one.
+
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define FUNCTION_WORD_VECTOR_KILLER_USE_AVX2
+#endif
+
+#include "function_word_vector_killer.h"
+
+namespace {
+
+#ifdef FUNCTION_WORD_VECTOR_KILLER_USE_AVX2
+// The AVX2 functions are compiled for AVX2 no matter what the rest of the
+// program is compiled for, but are only called if the processor supports it.
+bool CpuSupportsAvx2() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+const bool kCpuSupportsAvx2 = CpuSupportsAvx2();
+
+__attribute__((target("avx2")))
+const char* FindWordEndAvx2(const char*& it, const char* end) {
+// Checks 32 bytes at a time from "it" on and returns the first space or
+// newline (or "NULL" if there is none before the last (incomplete) block,
+// which starts at "it" afterwards).
+  const __m256i spaces = _mm256_set1_epi8(' '), newlines = _mm256_set1_epi8('\n');
+  for (; end-it >= 32; it += 32) {
+    const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(it));
+    const unsigned mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(bytes, spaces), _mm256_cmpeq_epi8(bytes, newlines)));
+    if (mask != 0)
+      return it+__builtin_ctz(mask);
+  }
+  return NULL;
+}
+
+__attribute__((target("avx2")))
+bool FoldAsciiCaseAvx2(const char*& in, const char* end, char*& out) {
+// Writes the bytes from "in" on in blocks of 32 to "out" with "A"-"Z"
+// replaced by "a"-"z" and returns "true" if there was a non-ASCII byte.
+  // Adding 0x80-'A' moves "A"-"Z" to the lowest (signed) values -128 to -103,
+  // so that a single comparison finds them.
+  const __m256i offset = _mm256_set1_epi8((char) (0x80-'A')), limit = _mm256_set1_epi8((char) (-128+26)), case_bit = _mm256_set1_epi8(0x20);
+  unsigned non_ascii = 0;
+  for (; end-in >= 32; in += 32, out += 32) {
+    const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in));
+    const __m256i is_upper_case = _mm256_cmpgt_epi8(limit, _mm256_add_epi8(bytes, offset));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), _mm256_or_si256(bytes, _mm256_and_si256(is_upper_case, case_bit)));
+    non_ascii |= _mm256_movemask_epi8(bytes);
+  }
+  return non_ascii != 0;
+}
+#endif
+
+void FoldLatin1SupplementCase(char* begin, char* end) {
+// Replaces the upper case letters of the Latin-1 Supplement ("À"-"Þ" except
+// "×", i.e. U+00C0 to U+00DE, which include the German umlauts) encoded in
+// UTF-8 by their lower case letters, which are 0x20 higher.
+  for (char* it = begin; it+1 < end; ++it) {
+    const unsigned char second_byte = it[1];
+    if (static_cast<unsigned char>(*it) == 0xC3 && second_byte >= 0x80 && second_byte <= 0x9E && second_byte != 0x97)
+      it[1] = second_byte+0x20;
+  }
+}
+
+}  // namespace
+
+const char* FindWordEnd(const char* begin, const char* end) {
+// Returns the first space or newline between "begin" and "end" (i.e. the end
+// of the word a word vector starts with) or "end" if there is none.
+  const char* it = begin;
+#ifdef FUNCTION_WORD_VECTOR_KILLER_USE_AVX2
+  if (kCpuSupportsAvx2) {
+    const char* word_end = FindWordEndAvx2(it, end);
+    if (word_end != NULL)
+      return word_end;
+  }
+#endif
+#if defined(__SSE2__)
+  const __m128i spaces = _mm_set1_epi8(' '), newlines = _mm_set1_epi8('\n');
+  for (; end-it >= 16; it += 16) {
+    const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(it));
+    const unsigned mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(bytes, spaces), _mm_cmpeq_epi8(bytes, newlines)));
+    if (mask != 0)
+      return it+__builtin_ctz(mask);
+  }
+#endif
+  for (; it < end; ++it) {
+    if (*it == ' ' || *it == '\n')
+      return it;
+  }
+  return end;
+}
+
+void FoldCase(const char* begin, const char* end, std::string& folded) {
+// Stores the UTF-8 string between "begin" and "end" in lower case in
+// "folded".
+  folded.resize(end-begin);
+  FoldCase(begin, end, &folded[0]);
+}
+
+void FoldCase(const char* begin, const char* end, char* folded) {
+// Writes the UTF-8 string between "begin" and "end" in lower case to
+// "folded" (which must have room for "end-begin" bytes). ASCII letters are
+// folded block by block; only if the string contains other characters, a
+// second pass folds the upper case letters of the Latin-1 Supplement (e.g.
+// "Über" becomes "über"). Letters beyond it are left as they are.
+  char* out = folded;
+  const char* in = begin;
+  bool has_non_ascii_bytes = false;
+#ifdef FUNCTION_WORD_VECTOR_KILLER_USE_AVX2
+  if (kCpuSupportsAvx2)
+    has_non_ascii_bytes = FoldAsciiCaseAvx2(in, end, out);
+#endif
+#if defined(__SSE2__)
+  const __m128i offset = _mm_set1_epi8((char) (0x80-'A')), limit = _mm_set1_epi8((char) (-128+26)), case_bit = _mm_set1_epi8(0x20);
+  for (; end-in >= 16; in += 16, out += 16) {
+    const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+    const __m128i is_upper_case = _mm_cmplt_epi8(_mm_add_epi8(bytes, offset), limit);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_or_si128(bytes, _mm_and_si128(is_upper_case, case_bit)));
+    has_non_ascii_bytes |= _mm_movemask_epi8(bytes) != 0;
+  }
+#endif
+  for (; in < end; ++in, ++out) {
+    const char character = *in;
+    *out = (character >= 'A' && character <= 'Z')? character+('a'-'A') : character;
+    has_non_ascii_bytes |= (character & 0x80) != 0;
+  }
+  if (has_non_ascii_bytes)
+    FoldLatin1SupplementCase(folded, folded+(end-begin));
+}
@@ -0,0 +1,201 @@
+// token_classifier.cc
+
+// Copyright 2019 E. Decker
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <map>
+
+#include "function_word_vector_killer.h"
+
+const std::vector<std::string> kTokenRuleNames = {"numbers", "ordinals", "punctuation", "urls", "emails", "length"};
+
+namespace {
+
+// Every rule but "kLengthRule" is a small deterministic automaton over the
+// bytes of a token (state 0 is its start, "kDead" means that the token can't
+// match any more). "TokenClassifier" combines them into a single automaton.
+const int kNumOfPatternRules = kLengthRule;
+const int kDead = -1;
+
+bool IsDigit(const unsigned char byte) { return byte >= '0' && byte <= '9'; }
+bool IsLetter(const unsigned char byte) { return (byte | 0x20) >= 'a' && (byte | 0x20) <= 'z'; }
+bool IsPunctuation(const unsigned char byte) { return byte > ' ' && byte < 0x7f && !IsDigit(byte) && !IsLetter(byte); }
+
+int NextNumberState(const int state, const unsigned char byte) {
+// [+-]? followed by groups of digits separated by '.' or ',' (e.g. "-3.14",
+// "1,000", "1.000.000,5" or ".5"). Accepting state: 2.
+  if (IsDigit(byte))
+    return 2;
+  if (byte == '.' || byte == ',')
+    return (state == 3)? kDead : 3;
+  return (state == 0 && (byte == '+' || byte == '-'))? 1 : kDead;
+}
+
+int NextOrdinalState(const int state, const unsigned char byte) {
+// Digits followed by "st", "nd", "rd", "th" (e.g. "21st") or by a period (as
+// in German, e.g. "2."). Accepting state: 6.
+  const unsigned char letter = byte | 0x20;
+  switch (state) {
+    case 0: return (IsDigit(byte))? 1 : kDead;
+    case 1: return (IsDigit(byte))? 1 : (byte == '.')? 6 : (letter == 's')? 2 : (letter == 'n')? 3 : (letter == 'r')? 4 : (letter == 't')? 5 : kDead;
+    case 2: return (letter == 't')? 6 : kDead;
+    case 3: case 4: return (letter == 'd')? 6 : kDead;
+    case 5: return (letter == 'h')? 6 : kDead;
+  }
+  return kDead;
+}
+
+int NextPunctuationState(const int state, const unsigned char byte) {
+// Nothing but punctuation characters (e.g. "--", "..." or "«»"): ASCII ones
+// and the UTF-8 sequences of the punctuation of Latin-1 ("¡§«¶·»¿"), of the
+// General Punctuation block (U+2010 to U+2027 and U+2030 to U+205E, e.g.
+// "‐–—‘’“”•…‰‹›") and of the CJK Symbols and Punctuation block ("、。" and
+// the brackets). States 2 to 7 are within a sequence. Accepting state: 1.
+  switch (state) {
+    case 0: case 1: return (IsPunctuation(byte))? 1 : (byte == 0xc2)? 2 : (byte == 0xe2)? 3 : (byte == 0xe3)? 6 : kDead;
+    case 2: return (byte == 0xa1 || byte == 0xa7 || byte == 0xab || byte == 0xb6 || byte == 0xb7 || byte == 0xbb || byte == 0xbf)? 1 : kDead;
+    case 3: return (byte == 0x80)? 4 : (byte == 0x81)? 5 : kDead;
+    case 4: return ((byte >= 0x90 && byte <= 0xa7) || byte >= 0xb0)? 1 : kDead; // the continuation bytes end at 0xbf
+    case 5: return (byte >= 0x80 && byte <= 0x9e)? 1 : kDead;
+    case 6: return (byte == 0x80)? 7 : kDead;
+    case 7: return ((byte >= 0x81 && byte <= 0x83) || (byte >= 0x88 && byte <= 0x91) || (byte >= 0x94 && byte <= 0x9f))? 1 : kDead;
+  }
+  return kDead;
+}
+
+int NextUrlState(const int state, const unsigned char byte) {
+// A scheme followed by "://" and anything (e.g. "https://example.com") or
+// "www." followed by anything. States 6 to 9 are "w", "ww", "www" and "www."
+// (which may still be the beginning of a scheme). Accepting state: 5.
+  const bool is_scheme_character = IsLetter(byte) || IsDigit(byte) || byte == '+' || byte == '-' || byte == '.';
+  switch (state) {
+    case 0: return ((byte | 0x20) == 'w')? 6 : (IsLetter(byte))? 1 : kDead;
+    case 6: case 7: case 8:
+      if (state < 8 && (byte | 0x20) == 'w')
+        return state+1;
+      if (state == 8 && byte == '.')
+        return 9;
+      // falls through
+    case 1: return (byte == ':')? 2 : (is_scheme_character)? 1 : kDead;
+    case 2: return (byte == '/')? 3 : kDead;
+    case 3: return (byte == '/')? 4 : kDead;
+    case 4: case 5: case 9: return 5;
+  }
+  return kDead;
+}
+
+int NextEmailState(const int state, const unsigned char byte) {
+// A local part, '@' and a domain with at least one '.' that doesn't end with
+// a '.' (e.g. "jane.doe@example.com"). Bytes of UTF-8 characters are allowed
+// in both parts. Accepting state: 5.
+  const bool is_domain_character = IsLetter(byte) || IsDigit(byte) || byte == '-' || byte >= 0x80;
+  switch (state) {
+    case 0: case 1: return (is_domain_character || byte == '.' || byte == '_' || byte == '%' || byte == '+')? 1 : (byte == '@' && state == 1)? 2 : kDead;
+    case 2: case 3: return (is_domain_character)? 3 : (byte == '.' && state == 3)? 4 : kDead;
+    case 4: case 5: return (is_domain_character)? 5 : (byte == '.' && state == 5)? 4 : kDead;
+  }
+  return kDead;
+}
+
+int NextState(const int rule, const int state, const unsigned char byte) {
+  if (state == kDead)
+    return kDead;
+  switch (rule) {
+    case kNumberRule: return NextNumberState(state, byte);
+    case kOrdinalRule: return NextOrdinalState(state, byte);
+    case kPunctuationRule: return NextPunctuationState(state, byte);
+    case kUrlRule: return NextUrlState(state, byte);
+    case kEmailRule: return NextEmailState(state, byte);
+  }
+  return kDead;
+}
+
+bool IsAccepting(const int rule, const int state) {
+  const int accepting_states[kNumOfPatternRules] = {2, 6, 1, 5, 5};
+  return state == accepting_states[rule];
+}
+
+}  // namespace
+
+TokenClassifier::TokenClassifier(const uint8_t enabled_rules, const size_t min_length, const size_t max_length)
+    : enabled_rules_(enabled_rules), min_length_(min_length), max_length_(max_length) {
+  // Builds the product of the automatons of the enabled rules: a state is a
+  // tuple of their states (state 0 = all dead, state 1 = all at their start),
+  // so that a single table lookup per byte runs all rules at once.
+  typedef std::array<int, kNumOfPatternRules> StateTuple;
+  StateTuple dead_tuple, start_tuple;
+  for (int rule = 0; rule < kNumOfPatternRules; ++rule) {
+    dead_tuple[rule] = kDead;
+    start_tuple[rule] = (enabled_rules & (1 << rule))? 0 : kDead;
+  }
+  std::vector<StateTuple> tuples = {dead_tuple, start_tuple};
+  std::map<StateTuple, uint16_t> tuple_indices = {{dead_tuple, 0}, {start_tuple, 1}};
+  std::vector<std::array<uint16_t, 256>> full_transitions;
+  for (size_t i = 0; i < tuples.size(); ++i) {
+    full_transitions.emplace_back();
+    uint8_t accepting_rules = 0;
+    for (int rule = 0; rule < kNumOfPatternRules; ++rule) {
+      if (IsAccepting(rule, tuples[i][rule]))
+        accepting_rules |= 1 << rule;
+    }
+    accepting_rules_.push_back(accepting_rules);
+    for (int byte = 0; byte < 256; ++byte) {
+      StateTuple next_tuple;
+      for (int rule = 0; rule < kNumOfPatternRules; ++rule)
+        next_tuple[rule] = NextState(rule, tuples[i][rule], byte);
+      const auto inserted = tuple_indices.emplace(next_tuple, tuples.size());
+      if (inserted.second)
+        tuples.push_back(next_tuple);
+      full_transitions[i][byte] = inserted.first->second;
+    }
+  }
+  // Bytes that lead to the same states everywhere share a column of the
+  // table, which keeps the table small enough for the L1 cache.
+  std::map<std::vector<uint16_t>, uint8_t> column_classes;
+  std::vector<std::vector<uint16_t>> columns;
+  for (int byte = 0; byte < 256; ++byte) {
+    std::vector<uint16_t> column(tuples.size());
+    for (size_t i = 0; i < tuples.size(); ++i)
+      column[i] = full_transitions[i][byte];
+    const auto inserted = column_classes.emplace(column, columns.size());
+    if (inserted.second)
+      columns.push_back(column);
+    byte_classes_[byte] = inserted.first->second;
+  }
+  num_of_byte_classes_ = columns.size();
+  transitions_.resize(tuples.size()*num_of_byte_classes_);
+  for (size_t i = 0; i < tuples.size(); ++i) {
+    for (size_t byte_class = 0; byte_class < columns.size(); ++byte_class)
+      transitions_[i*num_of_byte_classes_+byte_class] = columns[byte_class][i];
+  }
+}
+
+uint8_t TokenClassifier::Classify(const std::string_view token) const {
+// Returns the bit mask of the enabled rules "token" matches (bit i = rule i
+// of "kTokenRuleNames"). The length is counted in UTF-8 characters.
+  const bool checks_length = (enabled_rules_ & (1 << kLengthRule)) != 0;
+  uint16_t state = 1;
+  size_t num_of_characters = 0;
+  for (const char character : token) {
+    const unsigned char byte = character;
+    state = transitions_[state*num_of_byte_classes_+byte_classes_[byte]];
+    num_of_characters += (byte & 0xc0) != 0x80;
+    if (state == 0 && !checks_length)
+      break;
+  }
+  uint8_t matched_rules = accepting_rules_[state];
+  if (checks_length && (num_of_characters < min_length_ || (max_length_ > 0 && num_of_characters > max_length_)))
+    matched_rules |= 1 << kLengthRule;
+  return matched_rules;
+}
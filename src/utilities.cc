@@ -0,0 +1,43 @@
+// utilities.cc
+
+// Copyright 2019 E. Decker
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <fstream>
+#include <iostream>
+
+#include "function_word_vector_killer.h"
+
+const std::vector<std::string> kCategoryNames = {"adpositions", "articles_and_the_like", "conjunctions_and_subjunctions", "interjections", "interrogative_words", "numerals", "particles", "personal_pronouns_and_possessives", "temporal_words", "miscellaneous_words"};
+
+std::string SetToLowerCase(std::string string) {
+// Sets every character of a string to lower case (see "FoldCase()") and
+// returns the string as a whole.
+  std::string lower_case_string;
+  FoldCase(string.data(), string.data()+string.size(), lower_case_string);
+  return lower_case_string;
+}
+
+bool FileIsValid(const std::string& file) {
+// Checks if "file" is readable and returns "false" if not and "true" otherwise.
+  const std::ifstream file_stream(file);
+  if (!file_stream.is_open()) {
+    std::cerr << "ERROR: OPENING \"" << file << "\" FAILED! Make sure that the file exists and that the path is correct.\n";
+    return false;
+  } else if (file_stream.bad()) {
+    std::cerr << "ERROR: OPENING \"" << file << "\" FAILED!\n";
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,127 @@
+// vector_file_format.cc
+
+// Copyright 2019 E. Decker
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cstring>
+#include <regex>
+
+#include "function_word_vector_killer.h"
+
+namespace {
+
+// Result of checking the start of a word vector file against one of the two
+// layouts.
+enum LayoutMatch { kLayoutContradicted, kLayoutInconclusive, kLayoutConfirmed };
+
+LayoutMatch MatchBinaryLayout(const char* vector_begin, const char* end, const VectorFileHeader& header) {
+// Checks if the word vectors starting at "vector_begin" are stored in the
+// binary format of word2vec: a word, a space and "header.dimension" 4-byte
+// floats (optionally followed by a newline), so that every word vector has to
+// end exactly where the word of the next one starts. Up to 4 word vectors are
+// checked; the layout is inconclusive if "end" comes before the first one
+// ends (the file might have been cut there).
+  for (int i = 0; i < 4; ++i) {
+    const char* word_begin = vector_begin;
+    while (vector_begin < end && *vector_begin != ' ') {
+      if (*vector_begin == '\n')
+        return kLayoutContradicted; // a word can't contain a newline
+      vector_begin++;
+    }
+    if (vector_begin == word_begin && vector_begin < end)
+      return kLayoutContradicted; // nor can it be empty
+    if (end-vector_begin-1 < 4*header.dimension)
+      return (i > 0)? kLayoutConfirmed : kLayoutInconclusive;
+    vector_begin += 1+4*header.dimension;
+    if (vector_begin < end && *vector_begin == '\n')
+      vector_begin++;
+  }
+  return kLayoutConfirmed;
+}
+
+LayoutMatch MatchTextLayout(const char* values_begin, const char* end, const VectorFileHeader& header) {
+// Checks if the line starting at "values_begin" (behind the first word)
+// consists of exactly "header.dimension" numbers, as it does in a text file.
+  const char* line_end = static_cast<const char*>(memchr(values_begin, '\n', end-values_begin));
+  if (line_end == NULL)
+    return kLayoutInconclusive;
+  long long num_of_values = 0;
+  for (const char* it = values_begin; it < line_end; ++it) {
+    if (*it == '\0' || strchr("0123456789+-.eE \t\r", *it) == NULL)
+      return kLayoutContradicted;
+    if (*it != ' ' && *it != '\t' && *it != '\r' && (it == values_begin || it[-1] == ' ' || it[-1] == '\t'))
+      num_of_values++;
+  }
+  return (num_of_values == header.dimension)? kLayoutConfirmed : kLayoutContradicted;
+}
+
+}  // namespace
+
+VectorFileHeader ReadVectorFileHeader(const char* begin, const char* end) {
+// Checks if the word vector file between "begin" and "end" (which doesn't
+// need to be complete, its first few kilobytes are enough) starts with a
+// header line like "3000000 300" (i.e. vocabulary size and dimension, as it
+// is written by word2vec and fastText) and whether the word vectors following
+// it are stored as text or in the binary format of word2vec.
+  VectorFileHeader header;
+  const char* line_end = static_cast<const char*>(memchr(begin, '\n', end-begin));
+  std::cmatch match;
+  if (line_end == NULL || !std::regex_match(begin, line_end, match, (std::regex) " *([0-9]{1,18}) +([0-9]{1,9}) *\r?"))
+    return header;
+  header.is_present = true;
+  header.vocab_size = std::stoll(match[1]);
+  header.dimension = std::stoll(match[2]);
+  header.length = line_end+1-begin;
+  const char* word_end = static_cast<const char*>(memchr(line_end+1, ' ', end-line_end-1));
+  if (word_end == NULL)
+    return header;
+  // The format is told by the layout of the first word vectors: the binary
+  // values of a word vector can contain any byte, including newlines, so only
+  // the position of the next word tells where they end.
+  const LayoutMatch binary_layout = MatchBinaryLayout(line_end+1, end, header);
+  const LayoutMatch text_layout = MatchTextLayout(word_end+1, end, header);
+  if (binary_layout == kLayoutConfirmed && text_layout != kLayoutConfirmed) {
+    header.is_binary = true;
+    return header;
+  }
+  if (text_layout == kLayoutConfirmed && binary_layout != kLayoutConfirmed)
+    return header;
+  // If both layouts (or none of them) fit, the values of the first word vector
+  // decide: in a text file they are written as numbers, whereas in a binary
+  // file they are 4 bytes per value, which (nearly) always contain bytes that
+  // can't be part of a number. (Unless the first line can't be a text word
+  // vector, its end ends the check, so that the next word of a text file with
+  // only a few dimensions isn't taken for binary values.)
+  const char* values_end = std::min(end, word_end+1+std::min(4*header.dimension, 64ll));
+  for (const char* it = word_end+1; it < values_end && (*it != '\n' || text_layout == kLayoutContradicted); ++it) {
+    if (strchr("0123456789+-.eE \t\r", *it) == NULL || *it == '\0') {
+      header.is_binary = true;
+      break;
+    }
+  }
+  return header;
+}
+
+std::string FormatVectorFileHeader(const long long vocab_size, const VectorFileHeader& original_header) {
+// Returns the header line for a file with "vocab_size" word vectors of the
+// dimension given in "original_header". The line is padded with spaces to the
+// length of the original header (word2vec, fastText and gensim ignore them),
+// so that it can overwrite the original header once all word vectors have
+// been written.
+  std::string header = std::to_string(vocab_size)+" "+std::to_string(original_header.dimension);
+  if (header.length()+1 < original_header.length)
+    header.append(original_header.length-header.length()-1, ' ');
+  return header+'\n';
+}
@@ -0,0 +1,505 @@
+// vector_filter.cc
+
+// Copyright 2019 E. Decker
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <istream>
+#include <limits>
+#include <mutex>
+#include <thread>
+
+#include "function_word_vector_killer.h"
+
+namespace {
+
+class StdInputStream : public InputStream {
+// Reads from a "std::istream" (see "VectorFilter::Filter(std::istream&)").
+ public:
+  StdInputStream(std::istream& stream) : stream_(stream), num_of_consumed_bytes_(0) {}
+  long long Read(char* data, const size_t size) override {
+    stream_.read(data, size);
+    num_of_consumed_bytes_ += stream_.gcount();
+    return (stream_.bad())? -1 : stream_.gcount();
+  }
+  long long num_of_consumed_bytes() const override { return num_of_consumed_bytes_; }
+
+ private:
+  std::istream& stream_;
+  long long num_of_consumed_bytes_;
+};
+
+}  // namespace
+
+VectorFilter::VectorFilter(const WordFilter& word_filter, OutputStream& output, const KillerOptions& options)
+    : word_filter_(word_filter),
+      output_(output),
+      options_(options),
+      // Every write hands over whole word vectors (see "CallbackOutputStream").
+      writer_(new RangeWriter(output, std::numeric_limits<size_t>::max())),
+      writer_offset_(0),
+      buffer_(std::max(options.buffer_size, (size_t) 1 << 12)),
+      buffer_fill_(0),
+      header_was_read_(false),
+      is_finished_(false),
+      failed_(false),
+      function_word_was_removed_(word_filter.function_words().size(), false) {
+  if (options_.duplicate_handling == kKeepFirstOccurrence) {
+    // The buffer is overwritten again and again, so the set keeps copies of
+    // the words (unless the whole input is passed to "FilterMapped()").
+    seen_words_.reset(new WordFingerprintSet());
+  }
+}
+
+VectorFilter::~VectorFilter() {}
+
+bool VectorFilter::CanStream() {
+// Returns "false" (once with an error message) if the word vectors can't be
+// filtered as they are read: a word vector can't be removed as a duplicate
+// after it has been written.
+  if (options_.duplicate_handling == kKeepLastOccurrence && !failed_) {
+    std::cerr << "ERROR: WORD VECTORS THAT ARE FILTERED AS THEY ARE READ CAN'T BE DE-DUPLICATED KEEPING THE LAST OCCURRENCES!\n";
+    failed_ = true;
+  }
+  return !failed_;
+}
+
+bool VectorFilter::Filter(const char* data, size_t size) {
+// Adds the next piece of the input (of any size) and filters the buffered
+// word vectors whenever the buffer is full. Returns "false" once anything
+// failed.
+  if (!CanStream())
+    return false;
+  while (size > 0 && !failed_ && !is_finished_) {
+    const size_t num_of_copied_bytes = std::min(size, buffer_.size()-buffer_fill_);
+    memcpy(buffer_.data()+buffer_fill_, data, num_of_copied_bytes);
+    buffer_fill_ += num_of_copied_bytes;
+    statistics_.num_of_read_bytes += num_of_copied_bytes;
+    data += num_of_copied_bytes;
+    size -= num_of_copied_bytes;
+    if (buffer_fill_ == buffer_.size())
+      FilterBuffer(false);
+  }
+  return !failed_;
+}
+
+bool VectorFilter::Filter(InputStream& input, ProgressReporter* progress) {
+// Reads "input" up to its end (straight into the buffer) and filters it block
+// by block. Returns "false" if reading failed; errors of writing are returned
+// by "Finish()". Compressed input has to be decompressed by "input" (see
+// "GzipInputStream").
+  if (!CanStream())
+    return true;
+  while (!failed_ && !is_finished_) {
+    const long long num_of_read_bytes = input.Read(buffer_.data()+buffer_fill_, buffer_.size()-buffer_fill_);
+    if (num_of_read_bytes <= 0)
+      return num_of_read_bytes == 0;
+    buffer_fill_ += num_of_read_bytes;
+    statistics_.num_of_read_bytes += num_of_read_bytes;
+    if (buffer_fill_ == buffer_.size()) {
+      FilterBuffer(false);
+      if (progress != NULL)
+        progress->Update(input.num_of_consumed_bytes(), statistics_.num_of_read_bytes, statistics_.num_of_checked_vectors);
+    }
+  }
+  return true;
+}
+
+bool VectorFilter::Filter(std::istream& stream) {
+  StdInputStream input(stream);
+  return Filter(input);
+}
+
+bool VectorFilter::Finish() {
+// Filters the rest of the buffered word vectors (the last one doesn't need to
+// end with a newline) and writes everything that is left. Returns "false" if
+// anything failed. The "OutputStream" isn't closed.
+  if (is_finished_ || !CanStream())
+    return !failed_;
+  FilterBuffer(true);
+  is_finished_ = true;
+  if (!FinishWriting(buffer_fill_ > 0 && writer_->pending_range_end() == buffer_.data()+buffer_fill_ && buffer_[buffer_fill_-1] != '\n'))
+    failed_ = true;
+  return !failed_;
+}
+
+bool VectorFilter::FilterMapped(const char* data, const size_t size, const RunCheckpoint* resume_state, const ChunkCallback& chunk_written) {
+// Filters input that is in memory as a whole (e.g. a mapped file) instead of
+// being passed piece by piece. The input is split into chunks of complete
+// word vectors which are classified by "options_.num_of_threads" threads
+// (see "ClassifyChunk()"), while this thread writes the kept word vectors of
+// the chunks in their original order directly from "data" (in writes of up to
+// "options_.buffer_size" bytes). "chunk_written" (if given) is called after
+// every chunk, e.g. to report the progress or to save a checkpoint (see
+// "GetState()"); a run that is resumed from a "resume_state" starts where
+// that was taken (the output has to contain everything written up to there).
+// Since the whole input is known, duplicates can be removed keeping their
+// last occurrences as well. No data can follow (see "Finish()").
+  if (header_was_read_ || buffer_fill_ > 0 || is_finished_ || failed_) {
+    std::cerr << "ERROR: \"VectorFilter::FilterMapped()\" NEEDS THE WHOLE INPUT AT ONCE!\n";
+    failed_ = true;
+    return false;
+  }
+  const char* const end_of_input = data+size;
+  writer_.reset(new RangeWriter(output_, options_.buffer_size));
+  header_ = ReadVectorFileHeader(data, end_of_input);
+  header_was_read_ = true;
+  output_.SetInputFormat(header_);
+  const unsigned num_of_threads = std::max(options_.num_of_threads, 1u);
+  // Chunks are small enough to give every thread several of them (so that
+  // writing can start early) but big enough to keep the overhead low.
+  const size_t chunk_size = std::min(std::max(size/(8*num_of_threads), (size_t) 1 << 20), (size_t) 1 << 25);
+  std::vector<const char*> chunk_borders = {data+((resume_state != NULL)? resume_state->input_offset : header_.length)};
+  while (chunk_borders.back() < end_of_input) {
+    const char* chunk_end = chunk_borders.back()+std::min(chunk_size, (size_t) (end_of_input-chunk_borders.back()));
+    if (chunk_end < end_of_input) {
+      if (header_.is_binary) { // binary word vectors can only be found by skipping from one to the next
+        const char* vector_end = chunk_borders.back();
+        while (vector_end != NULL && vector_end < chunk_end)
+          vector_end = FindEndOfVector(vector_end, end_of_input, true);
+        chunk_end = (vector_end == NULL)? end_of_input : vector_end;
+      } else { // moves the border behind the next newline
+        chunk_end = static_cast<const char*>(memchr(chunk_end, '\n', end_of_input-chunk_end));
+        chunk_end = (chunk_end == NULL)? end_of_input : chunk_end+1;
+      }
+    }
+    chunk_borders.push_back(chunk_end);
+  }
+  const size_t num_of_chunks = chunk_borders.size()-1;
+  std::vector<Chunk> chunks(num_of_chunks);
+  std::mutex chunks_mutex;
+  std::condition_variable chunk_classified;
+  size_t next_chunk_to_classify = 0;
+  auto classify_chunks = [&]() { // run by every thread
+    while (true) {
+      size_t index;
+      {
+        std::lock_guard<std::mutex> lock(chunks_mutex);
+        if (next_chunk_to_classify == num_of_chunks)
+          return;
+        index = next_chunk_to_classify++;
+      }
+      Chunk chunk;
+      ClassifyChunk(chunk_borders[index], chunk_borders[index+1], chunk);
+      {
+        std::lock_guard<std::mutex> lock(chunks_mutex);
+        chunks[index] = std::move(chunk);
+        chunks[index].is_classified = true;
+      }
+      chunk_classified.notify_all();
+    }
+  };
+  std::vector<std::thread> threads;
+  if (num_of_threads > 1) {
+    for (unsigned i = 0; i < num_of_threads; ++i)
+      threads.emplace_back(classify_chunks);
+  }
+  auto wait_for_chunk = [&](const size_t index) {
+    if (num_of_threads > 1) {
+      std::unique_lock<std::mutex> lock(chunks_mutex);
+      chunk_classified.wait(lock, [&]() { return chunks[index].is_classified; });
+    } else if (!chunks[index].is_classified) {
+      ClassifyChunk(chunk_borders[index], chunk_borders[index+1], chunks[index]);
+      chunks[index].is_classified = true;
+    }
+  };
+  // If function words shall only be removed at their first occurrence, this
+  // is decided here because only this thread sees the chunks in order - just
+  // like duplicates (see "MarkDuplicates()").
+  if (resume_state != NULL) {
+    function_word_was_removed_ = resume_state->function_word_was_removed;
+    AddRunStatistics(resume_state->statistics, statistics_);
+  }
+  if (options_.duplicate_handling != kKeepAllOccurrences)
+    seen_words_.reset(new WordFingerprintSet(data, end_of_input)); // the words are compared in "data"
+  std::vector<bool> duplicates_are_marked(num_of_chunks, !seen_words_);
+  if (options_.duplicate_handling == kKeepLastOccurrence) {
+    // The last occurrence of a word is only known at the end of the input, so
+    // all chunks are classified first and checked from back to front.
+    for (size_t i = 0; i < num_of_chunks; ++i)
+      wait_for_chunk(i);
+    for (size_t i = num_of_chunks; i-- > 0;)
+      MarkDuplicates(chunks[i], *seen_words_, true);
+    duplicates_are_marked.assign(num_of_chunks, true);
+  }
+  auto prepare_chunk = [&](const size_t index) {
+    wait_for_chunk(index);
+    if (!duplicates_are_marked[index]) {
+      MarkDuplicates(chunks[index], *seen_words_, false);
+      duplicates_are_marked[index] = true;
+    }
+  };
+  // The header line is copied as it is for now and corrected once the number
+  // of kept word vectors is known (by the owner of "output_", see
+  // "statistics()"). But if the output can't be changed afterwards (e.g.
+  // because it is a pipe), all chunks are classified first in order to count
+  // the kept word vectors.
+  if (resume_state != NULL)
+    writer_offset_ = resume_state->output_offset; // the header line is written already
+  else if (header_.is_present && !output_.CanRewriteHeader()) {
+    long long num_of_kept_vectors = 0;
+    std::vector<bool> function_word_is_counted(function_word_was_removed_.size(), false);
+    for (size_t i = 0; i < num_of_chunks; ++i) {
+      prepare_chunk(i);
+      num_of_kept_vectors += chunks[i].num_of_checked_vectors-chunks[i].num_of_removed_vectors;
+      for (const auto& line_range : chunks[i].line_ranges) {
+        if (line_range.function_word_index >= 0 && !function_word_is_counted[line_range.function_word_index]) {
+          function_word_is_counted[line_range.function_word_index] = true;
+          num_of_kept_vectors--;
+        }
+      }
+    }
+    const std::string header = FormatVectorFileHeader(num_of_kept_vectors, header_);
+    output_.WriteHeader(header.data(), header.length());
+    writer_offset_ = header.length();
+  } else if (header_.is_present) {
+    output_.WriteHeader(data, header_.length);
+    writer_offset_ = header_.length;
+  }
+  for (size_t i = 0; i < num_of_chunks; ++i) {
+    prepare_chunk(i);
+    WriteChunk(chunks[i]);
+    std::vector<LineRange>().swap(chunks[i].line_ranges);
+    statistics_.num_of_read_bytes = chunk_borders[i+1]-data;
+    if (chunk_written)
+      chunk_written();
+  }
+  for (auto& thread : threads)
+    thread.join();
+  is_finished_ = true;
+  if (!FinishWriting(writer_->pending_range_end() == end_of_input && end_of_input[-1] != '\n'))
+    failed_ = true;
+  return !failed_;
+}
+
+bool VectorFilter::GetState(RunCheckpoint& state) {
+// Writes everything that is pending, syncs the output and stores how far the
+// input of "FilterMapped()" has been filtered and the output written (see
+// "RunCheckpoint") in "state", so that the run can be resumed from there.
+// Returns "false" if writing or syncing failed.
+  if (!writer_->Flush() || !output_.Sync())
+    return false;
+  state.input_offset = statistics_.num_of_read_bytes;
+  state.output_offset = writer_offset_+writer_->num_of_written_bytes();
+  state.statistics = statistics_;
+  state.statistics.num_of_written_bytes += writer_->num_of_written_bytes();
+  state.statistics.num_of_writes += writer_->num_of_writes();
+  state.function_word_was_removed = function_word_was_removed_;
+  return true;
+}
+
+void VectorFilter::FilterBuffer(const bool is_end_of_input) {
+// Classifies all complete word vectors in the buffer at once, just like a
+// chunk of a mapped file (see "Killer::FilterMappedFile()"), and writes the
+// kept ones. The incomplete word vector at the end is moved to the front of
+// the buffer (which is made bigger if it can't even hold a single word
+// vector). The header line is read from the first block.
+  const char* block_begin = buffer_.data(), *end_of_block = buffer_.data()+buffer_fill_;
+  if (!header_was_read_) {
+    header_ = ReadVectorFileHeader(block_begin, end_of_block);
+    output_.SetInputFormat(header_);
+    if (header_.is_present)
+      output_.WriteHeader(block_begin, header_.length);
+    block_begin += header_.length;
+    header_was_read_ = true;
+  }
+  // Finds the end of the last complete word vector in the buffer.
+  const char* end_of_complete_vectors = block_begin;
+  if (is_end_of_input)
+    end_of_complete_vectors = end_of_block;
+  else if (header_.is_binary) {
+    for (const char* vector_end = block_begin; vector_end != NULL; vector_end = FindEndOfVector(vector_end, end_of_block, false))
+      end_of_complete_vectors = vector_end;
+  } else {
+    const char* last_newline = static_cast<const char*>(memrchr(block_begin, '\n', end_of_block-block_begin));
+    if (last_newline != NULL)
+      end_of_complete_vectors = last_newline+1;
+  }
+  Chunk chunk;
+  ClassifyChunk(block_begin, end_of_complete_vectors, chunk);
+  if (seen_words_)
+    MarkDuplicates(chunk, *seen_words_, false);
+  WriteChunk(chunk);
+  if (is_end_of_input)
+    return; // "Finish()" still needs to see where the last write ended
+  if (!writer_->Flush()) // the buffer is about to be overwritten
+    failed_ = true;
+  buffer_fill_ = end_of_block-end_of_complete_vectors;
+  memmove(buffer_.data(), end_of_complete_vectors, buffer_fill_);
+  if (end_of_complete_vectors == block_begin)
+    buffer_.resize(2*buffer_.size());
+}
+
+bool VectorFilter::FinishWriting(const bool last_line_is_unterminated) {
+// Writes what is left to write and terminates the last line of a text file
+// (if the input doesn't end with a newline). Returns "false" if anything
+// couldn't be written.
+  bool write_failed = !writer_->Flush();
+  const auto start = std::chrono::steady_clock::now();
+  if (last_line_is_unterminated && !header_.is_binary && !output_.Write("\n", 1))
+    write_failed = true;
+  statistics_.write_seconds += writer_->write_seconds()+std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+  statistics_.num_of_written_bytes += writer_->num_of_written_bytes();
+  statistics_.num_of_writes += writer_->num_of_writes();
+  return !write_failed;
+}
+
+void VectorFilter::ClassifyChunk(const char* chunk_begin, const char* chunk_end, Chunk& chunk) const {
+// Checks every word vector between "chunk_begin" and "chunk_end" and stores
+// the ranges of consecutive word vectors to keep in "chunk". Word vectors of
+// function words are removed right away - unless function words shall only be
+// removed at their first occurrence: then those word vectors are stored as
+// well. Word vectors whose word matches a token rule (e.g. every numeric
+// string if the numerals are selected, see "TokenClassifier") are removed
+// without looking the word up. Compound words of function words (see
+// "CompoundMatcher") are only searched for if the word itself isn't found.
+// Duplicates can only be found in the order of the input and are therefore
+// marked later (see "MarkDuplicates()").
+  const bool measure_time = !options_.statistics_file.empty();
+  std::chrono::steady_clock::time_point times[3];
+  std::string word;
+  const char* kept_range_begin = chunk_begin, *vector_begin = chunk_begin;
+  while (vector_begin < chunk_end) {
+    const char* vector_end = FindEndOfVector(vector_begin, chunk_end, true);
+    if (vector_end == NULL) // the last word vector of the input might be incomplete
+      vector_end = chunk_end;
+    const char* word_end = GetWord(vector_begin, vector_end, word);
+    if (measure_time)
+      times[0] = std::chrono::steady_clock::now();
+    const uint8_t matched_rules = word_filter_.MatchTokenRules(word);
+    if (measure_time)
+      times[1] = std::chrono::steady_clock::now();
+    const int function_word_index = (matched_rules != 0)? -1 : word_filter_.FindFunctionWord(word);
+    const uint16_t compound_categories = (matched_rules == 0 && function_word_index < 0)? word_filter_.MatchCompound(word) : 0;
+    if (measure_time) {
+      times[2] = std::chrono::steady_clock::now();
+      chunk.token_rule_seconds += std::chrono::duration<double>(times[1]-times[0]).count();
+      chunk.lookup_seconds += std::chrono::duration<double>(times[2]-times[1]).count();
+    }
+    if (matched_rules != 0 || function_word_index >= 0 || compound_categories != 0) {
+      if (vector_begin > kept_range_begin)
+        chunk.line_ranges.push_back({kept_range_begin, vector_begin, -1});
+      if (function_word_index >= 0 && options_.remove_only_first_occurrence)
+        chunk.line_ranges.push_back({vector_begin, vector_end, function_word_index});
+      else {
+        chunk.num_of_removed_vectors++;
+        if (matched_rules != 0)
+          CountMatches(matched_rules, chunk.num_of_removed_vectors_per_rule);
+        else if (compound_categories != 0) {
+          chunk.num_of_removed_compounds++;
+          CountMatches(compound_categories, chunk.num_of_removed_vectors_per_category);
+        } else
+          CountMatches(word_filter_.function_words().category_mask(function_word_index) & word_filter_.selected_categories(), chunk.num_of_removed_vectors_per_category);
+      }
+      kept_range_begin = vector_end;
+    } else if (options_.duplicate_handling != kKeepAllOccurrences) {
+      // Every kept word vector gets a range of its own, so that it can still
+      // be removed as a duplicate (see "MarkDuplicates()").
+      chunk.line_ranges.push_back({vector_begin, vector_end, -1, WordFingerprintSet::Fingerprint(std::string_view(vector_begin, word_end-vector_begin))});
+      kept_range_begin = vector_end;
+    }
+    chunk.num_of_checked_vectors++;
+    vector_begin = vector_end;
+  }
+  if (chunk_end > kept_range_begin)
+    chunk.line_ranges.push_back({kept_range_begin, chunk_end, -1});
+}
+
+void VectorFilter::MarkDuplicates(Chunk& chunk, WordFingerprintSet& seen_words, const bool backwards) const {
+// Marks the kept word vectors of a classified "chunk" whose word is in
+// "seen_words" already as duplicates and adds the others to "seen_words". The
+// chunks have to be passed in the order of the input - or, to keep the last
+// occurrence of every word, in reverse order with "backwards" = "true".
+  const size_t num_of_line_ranges = chunk.line_ranges.size();
+  for (size_t i = 0; i < num_of_line_ranges; ++i) {
+    LineRange& line_range = chunk.line_ranges[(backwards)? num_of_line_ranges-1-i : i];
+    if (line_range.function_word_index >= 0)
+      continue;
+    const std::string_view word(line_range.begin, FindWordEnd(line_range.begin, line_range.end)-line_range.begin);
+    if (!seen_words.Insert(word, line_range.fingerprint)) {
+      line_range.is_duplicate = true;
+      chunk.num_of_removed_vectors++;
+      chunk.num_of_removed_duplicates++;
+    }
+  }
+}
+
+void VectorFilter::WriteChunk(const Chunk& chunk) {
+// Writes the kept word vectors of a classified "chunk" and adds its counters
+// to "statistics_". The chunks have to be written in the order of the input,
+// so that only the first occurrence of a function word is removed (if
+// "options_.remove_only_first_occurrence" is "true").
+  std::array<int, kNumOfCategories> num_of_removed_vectors_per_category = chunk.num_of_removed_vectors_per_category;
+  statistics_.num_of_removed_vectors += chunk.num_of_removed_vectors;
+  for (const auto& line_range : chunk.line_ranges) {
+    if (line_range.is_duplicate)
+      continue;
+    if (line_range.function_word_index >= 0 && !function_word_was_removed_[line_range.function_word_index]) {
+      function_word_was_removed_[line_range.function_word_index] = true;
+      statistics_.num_of_removed_vectors++;
+      CountMatches(word_filter_.function_words().category_mask(line_range.function_word_index) & word_filter_.selected_categories(), num_of_removed_vectors_per_category);
+    } else
+      writer_->Write(line_range.begin, line_range.end);
+  }
+  statistics_.num_of_checked_vectors += chunk.num_of_checked_vectors;
+  for (int i = 0; i < kNumOfTokenRules; ++i)
+    statistics_.num_of_removed_vectors_per_rule[i] += chunk.num_of_removed_vectors_per_rule[i];
+  statistics_.num_of_removed_compounds += chunk.num_of_removed_compounds;
+  statistics_.num_of_removed_duplicates += chunk.num_of_removed_duplicates;
+  for (int i = 0; i < kNumOfCategories; ++i)
+    statistics_.num_of_removed_vectors_per_category[i] += num_of_removed_vectors_per_category[i];
+  statistics_.lookup_seconds += chunk.lookup_seconds;
+  statistics_.token_rule_seconds += chunk.token_rule_seconds;
+}
+
+template <size_t kSize>
+void VectorFilter::CountMatches(const uint16_t mask, std::array<int, kSize>& counts) {
+// Counts a removed word vector in every category (or token rule) of "mask".
+  for (size_t i = 0; i < kSize; ++i) {
+    if (mask & (1 << i))
+      counts[i]++;
+  }
+}
+
+const char* VectorFilter::FindEndOfVector(const char* vector_begin, const char* end, const bool is_end_of_input) const {
+// Returns the end of the word vector starting at "vector_begin" or "NULL" if
+// it doesn't end before "end". A word vector in a text file is a line; in a
+// binary file it is the word, a space and "header_.dimension" 4-byte floats
+// (optionally followed by a newline, which is treated as part of the word
+// vector). "is_end_of_input" tells whether more data might follow "end".
+  if (!header_.is_binary) {
+    const char* line_end = static_cast<const char*>(memchr(vector_begin, '\n', end-vector_begin));
+    return (line_end == NULL)? NULL : line_end+1;
+  }
+  const char* word_end = static_cast<const char*>(memchr(vector_begin, ' ', end-vector_begin));
+  if (word_end == NULL || end-word_end-1 < 4*header_.dimension)
+    return NULL;
+  const char* vector_end = word_end+1+4*header_.dimension;
+  if (vector_end < end)
+    return (*vector_end == '\n')? vector_end+1 : vector_end;
+  return (is_end_of_input)? vector_end : NULL; // a newline might still follow
+}
+
+const char* VectorFilter::GetWord(const char* line_begin, const char* line_end, std::string& word) {
+// Stores the word of the word vector between "line_begin" and "line_end" in
+// lower case in "word" (note that the word comparison is not case
+// sensitive!) and returns its end. The word ends at the first space - or at
+// the newline if the line consists of nothing but the word.
+  const char* word_end = FindWordEnd(line_begin, line_end);
+  FoldCase(line_begin, word_end, word);
+  return word_end;
+}
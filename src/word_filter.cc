@@ -0,0 +1,100 @@
+// word_filter.cc
+
+// Copyright 2019 E. Decker
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "function_word_vector_killer.h"
+
+namespace {
+
+std::vector<bool> GetWordsToRemove(const uint16_t category_mask) {
+  std::vector<bool> words_to_remove(kNumOfCategories);
+  for (int i = 0; i < kNumOfCategories; ++i)
+    words_to_remove[i] = (category_mask & (1 << i)) != 0;
+  return words_to_remove;
+}
+
+KillerOptions WithDataDirectory(KillerOptions options, const std::string& data_directory) {
+  options.data_directory = data_directory;
+  return options;
+}
+
+}  // namespace
+
+uint8_t GetTokenRules(const uint16_t selected_categories, const KillerOptions& options) {
+// Returns the bit mask of the token rules of a run: numeric strings are
+// removed together with the numerals, and the length rule is used if a
+// length limit is given.
+  uint8_t token_rules = options.token_rules;
+  if (selected_categories & (1 << 5))
+    token_rules |= 1 << kNumberRule;
+  if (options.min_word_length > 0 || options.max_word_length > 0)
+    token_rules |= 1 << kLengthRule;
+  return token_rules;
+}
+
+WordFilter::WordFilter(const std::string& data_directory, const uint16_t category_mask, const KillerOptions& options)
+    : loaded_function_words_(LoadFunctionWordSet(GetWordsToRemove(category_mask), 0, WithDataDirectory(options, data_directory))),
+      function_words_(loaded_function_words_.get()),
+      selected_categories_(category_mask),
+      token_classifier_(GetTokenRules(category_mask, options), options.min_word_length, options.max_word_length) {
+  if (function_words_ != NULL && options.match_compounds)
+    compound_matcher_.reset(new CompoundMatcher(*function_words_, selected_categories_));
+}
+
+WordFilter::WordFilter(const FunctionWordSet& function_words, const uint16_t category_mask, const KillerOptions& options)
+    : function_words_(&function_words),
+      selected_categories_(category_mask),
+      token_classifier_(GetTokenRules(category_mask, options), options.min_word_length, options.max_word_length) {
+  if (options.match_compounds)
+    compound_matcher_.reset(new CompoundMatcher(*function_words_, selected_categories_));
+}
+
+WordFilter::~WordFilter() {}
+
+int WordFilter::FindFunctionWord(const std::string_view folded_word) const {
+// Returns the index of "folded_word" in "function_words()" or -1 if it isn't
+// a function word of a selected category.
+  const int function_word_index = function_words_->Find(folded_word);
+  if (function_word_index >= 0 && (function_words_->category_mask(function_word_index) & selected_categories_) == 0)
+    return -1; // a word of a category that wasn't selected
+  return function_word_index;
+}
+
+WordMatch WordFilter::Classify(const std::string_view folded_word) const {
+// Checks a word (in lower case, see "FoldCase()") against the token rules,
+// the function words and - only if it is neither - the compounds of function
+// words.
+  WordMatch match;
+  match.matched_rules = MatchTokenRules(folded_word);
+  if (match.matched_rules == 0)
+    match.function_word_index = FindFunctionWord(folded_word);
+  if (match.matched_rules == 0 && match.function_word_index < 0)
+    match.compound_categories = MatchCompound(folded_word);
+  return match;
+}
+
+bool WordFilter::Removes(const std::string_view token) const {
+// Returns "true" if the word vector of "token" is removed (by a token rule,
+// as a function word or as a compound of them; duplicates and
+// "remove_only_first_occurrence" depend on the word vectors before it and are
+// left to "VectorFilter"). The token is folded to lower case on the stack, so
+// nothing is allocated. Longer tokens than "kMaxFoldedTokenLength" bytes
+// can't be function words and are only checked against the token rules.
+  if (token.size() > kMaxFoldedTokenLength)
+    return MatchTokenRules(token) != 0;
+  char folded_token[kMaxFoldedTokenLength];
+  FoldCase(token.data(), token.data()+token.size(), folded_token);
+  return Classify(std::string_view(folded_token, token.size())).IsMatch();
+}
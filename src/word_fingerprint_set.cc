@@ -0,0 +1,108 @@
+// word_fingerprint_set.cc
+
+// Copyright 2019 E. Decker
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstring>
+
+#include "function_word_vector_killer.h"
+
+namespace {
+
+const uint64_t kEmptySlot = 0; // fingerprint of an empty slot (words that get it are moved to 1)
+
+uint64_t Mix(uint64_t value) {
+// Final mixing step of MurmurHash3: every bit of "value" changes about half of
+// the bits of the result, so that the lower bits can be used as slot index.
+  value ^= value >> 33;
+  value *= 0xff51afd7ed558ccdull;
+  value ^= value >> 33;
+  value *= 0xc4ceb9fe1a85ec53ull;
+  return value ^ (value >> 33);
+}
+
+}  // namespace
+
+WordFingerprintSet::WordFingerprintSet(const char* source_begin, const char* source_end) : source_begin_(source_begin), source_end_(source_end), num_of_words_(0) {
+  slots_.resize(1 << 16);
+}
+
+uint64_t WordFingerprintSet::Fingerprint(const std::string_view word) {
+// Returns a 64-bit fingerprint of "word" (8 bytes are taken at a time, which
+// is a lot faster than hashing byte by byte for the long words of some
+// vocabularies).
+  uint64_t fingerprint = 0x9e3779b97f4a7c15ull ^ word.size();
+  size_t i = 0;
+  for (; i+8 <= word.size(); i += 8) {
+    uint64_t block;
+    memcpy(&block, word.data()+i, 8);
+    fingerprint = Mix(fingerprint ^ block);
+  }
+  if (i < word.size()) {
+    uint64_t block = 0;
+    memcpy(&block, word.data()+i, word.size()-i);
+    fingerprint = Mix(fingerprint ^ block);
+  }
+  return (fingerprint == kEmptySlot)? 1 : fingerprint;
+}
+
+bool WordFingerprintSet::Insert(const std::string_view word, const uint64_t fingerprint) {
+// Adds "word" (with its "Fingerprint()") to the set and returns "false" if
+// it was in the set already. Only if the fingerprints are equal the words
+// themselves are compared - in the source or in "arena_".
+  if (2*num_of_words_ >= slots_.size())
+    Grow();
+  size_t slot_index = fingerprint & (slots_.size()-1);
+  while (slots_[slot_index].fingerprint != kEmptySlot) {
+    if (slots_[slot_index].fingerprint == fingerprint && WordAt(slots_[slot_index].position) == word)
+      return false;
+    slot_index = (slot_index+1) & (slots_.size()-1);
+  }
+  slots_[slot_index].fingerprint = fingerprint;
+  if (source_begin_ != NULL) {
+    slots_[slot_index].position = word.data()-source_begin_;
+  } else {
+    // Without a source the words are copied (each followed by a newline,
+    // which can't be part of a word).
+    slots_[slot_index].position = arena_.size();
+    arena_.append(word.data(), word.size());
+    arena_ += '\n';
+  }
+  num_of_words_++;
+  return true;
+}
+
+std::string_view WordFingerprintSet::WordAt(const uint64_t position) const {
+// Returns the word stored at "position" of the source (where it ends at the
+// next space or newline, see "FindWordEnd()") or of "arena_".
+  const char* begin = (source_begin_ != NULL)? source_begin_ : arena_.data();
+  const char* end = (source_begin_ != NULL)? source_end_ : arena_.data()+arena_.size();
+  const char* word_begin = begin+position;
+  return std::string_view(word_begin, FindWordEnd(word_begin, end)-word_begin);
+}
+
+void WordFingerprintSet::Grow() {
+// Doubles the number of slots (the fingerprints are kept, so nothing needs to
+// be hashed again).
+  std::vector<Slot> old_slots(2*slots_.size());
+  old_slots.swap(slots_);
+  for (const Slot& slot : old_slots) {
+    if (slot.fingerprint == kEmptySlot)
+      continue;
+    size_t slot_index = slot.fingerprint & (slots_.size()-1);
+    while (slots_[slot_index].fingerprint != kEmptySlot)
+      slot_index = (slot_index+1) & (slots_.size()-1);
+    slots_[slot_index] = slot;
+  }
+}
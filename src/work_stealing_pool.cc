@@ -0,0 +1,75 @@
+// work_stealing_pool.cc
+
+// Copyright 2019 E. Decker
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+
+#include "function_word_vector_killer.h"
+
+WorkStealingPool::WorkStealingPool(const unsigned num_of_threads) : next_worker_(0) {
+  for (unsigned i = 0; i < std::max(num_of_threads, 1u); ++i)
+    workers_.emplace_back(new Worker);
+}
+
+void WorkStealingPool::Add(std::function<void()> task) {
+// Adds "task" to the queues of the workers in turns (tasks should be added
+// from the longest to the shortest, so that every worker starts with a long
+// one).
+  workers_[next_worker_]->tasks.push_back(std::move(task));
+  next_worker_ = (next_worker_+1) % workers_.size();
+}
+
+void WorkStealingPool::Run() {
+// Runs all added tasks and returns when they are done. The first worker runs
+// on the calling thread.
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < workers_.size(); ++i)
+    threads.emplace_back([this, i]() { Work(i); });
+  Work(0);
+  for (auto& thread : threads)
+    thread.join();
+}
+
+void WorkStealingPool::Work(const size_t worker_index) {
+// Runs the tasks of the worker from the front of its queue. Once its queue is
+// empty, it steals tasks from the back of the queues of the other workers
+// (the back, so that it doesn't compete with their owners for the same end).
+// No task adds new ones, so the worker is done once all queues are empty.
+  std::function<void()> task;
+  while (true) {
+    bool has_task = false;
+    {
+      Worker& worker = *workers_[worker_index];
+      std::lock_guard<std::mutex> lock(worker.mutex);
+      if (!worker.tasks.empty()) {
+        task = std::move(worker.tasks.front());
+        worker.tasks.pop_front();
+        has_task = true;
+      }
+    }
+    for (size_t i = 1; !has_task && i < workers_.size(); ++i) {
+      Worker& victim = *workers_[(worker_index+i) % workers_.size()];
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      if (!victim.tasks.empty()) {
+        task = std::move(victim.tasks.back());
+        victim.tasks.pop_back();
+        has_task = true;
+      }
+    }
+    if (!has_task)
+      return;
+    task();
+  }
+}
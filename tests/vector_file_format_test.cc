@@ -0,0 +1,60 @@
+// vector_file_format_test.cc
+
+// Copyright 2019 E. Decker
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Checks that "ReadVectorFileHeader()" tells text and binary word vector
+// files apart (run by "make test").
+
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "function_word_vector_killer.h"
+
+namespace {
+
+int num_of_failures = 0;
+
+std::string BinaryVector(const std::string& word, const std::string& values) {
+  return word+' '+values+'\n';
+}
+
+void Check(const std::string& name, const std::string& file, const bool expected_is_binary) {
+  const VectorFileHeader header = ReadVectorFileHeader(file.data(), file.data()+file.size());
+  if (header.is_present && header.is_binary == expected_is_binary)
+    return;
+  std::cerr << "FAILED: " << name << " was detected as " << ((header.is_binary)? "binary" : "text") << ".\n";
+  num_of_failures++;
+}
+
+}  // namespace
+
+int main() {
+  // 1.0f is "00 00 80 3F"; "0A 00 80 3F" is a float whose first byte is a
+  // newline, which must not end the word vector.
+  const std::string one("\x00\x00\x80\x3f", 4), newline_first("\x0a\x00\x80\x3f", 4);
+  Check("binary file with a newline in the first value", "5 2\n"+BinaryVector("hello", newline_first+one)+BinaryVector("the", one+one)+BinaryVector("world", one+one)+BinaryVector("and", one+one)+BinaryVector("tree", one+one), true);
+  Check("binary file with a single word vector", "1 2\n"+BinaryVector("hello", newline_first+one), true);
+  Check("binary file without newlines between the word vectors", "2 2\nhello "+newline_first+one+"world "+one+one, true);
+  Check("binary file cut in its first word vector", "5 2\nhello "+newline_first, true);
+  Check("binary file", "2 2\n"+BinaryVector("hello", one+one)+BinaryVector("world", one+one), true);
+  Check("text file", "3 2\nthe 0.1 0.2\nfoo 1 2\nbar 3 4\n", false);
+  Check("text file with trailing spaces", "2 3\nthe 0.1 -0.2 3e-2 \nfoo 1 2 3 \n", false);
+  Check("text file with one dimension", "3 1\na 1\nb 2\nc 3\n", false);
+  if (num_of_failures > 0)
+    return 1;
+  std::cout << "All tests passed.\n";
+  return 0;
+}